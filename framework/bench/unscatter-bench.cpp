@@ -0,0 +1,239 @@
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "CLI/App.hpp"
+#include "CLI/Formatter.hpp"
+#include "CLI/Config.hpp"
+
+#include "../include/addr.hpp"
+#include "../include/utils.hpp"
+#include "../include/framework.hpp"
+#include "../include/oracle.hpp"
+#include "../include/hash-function.hpp"
+
+#define BENCH_SEED 0x5eed
+#define BENCH_REPETITIONS 5
+
+/*
+* Allocation counting, every heap allocation of the process goes through here
+*/
+static std::atomic<uint64_t> allocations{0};
+
+// Not inlined, otherwise the compiler pairs the malloc and free inside with
+// the new and delete expressions of the callers
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { ::operator delete(p); }
+
+/*
+* Oracle without measurement cost, used to isolate the framework overhead
+*/
+class StubOracle : public Oracle {
+ public:
+  uint64_t mask;
+  StubOracle(int runs, int confidence, uint64_t mask) : Oracle(runs, confidence) {
+    this->mask = mask;
+    this->output_classes = 2;
+  }
+  uint64_t oracle(pointer addr) { return __builtin_parityll(addr & this->mask); }
+};
+
+/*
+* Runs a benchmark BENCH_REPETITIONS times and reports the median ns/op and
+* the allocations/op of the last repetition
+*/
+static void run_bench(std::string filter, std::string name, size_t ops, std::function<void()> setup,
+                      std::function<void()> body) {
+  if (name.find(filter) == std::string::npos) {
+    return;
+  }
+  std::vector<double> ns_per_op;
+  uint64_t allocs = 0;
+  for (size_t r = 0; r < BENCH_REPETITIONS; r++) {
+    setup();
+    auto allocs_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto stop = std::chrono::steady_clock::now();
+    allocs = allocations.load() - allocs_before;
+    ns_per_op.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / ops);
+  }
+  std::sort(ns_per_op.begin(), ns_per_op.end());
+  std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed
+            << std::setprecision(1) << ns_per_op[BENCH_REPETITIONS / 2] << " ns/op" << std::setw(12)
+            << std::setprecision(2) << (double)allocs / ops << " allocs/op" << std::setw(12) << ops << " ops\n";
+}
+
+/*
+* Synthetic dram layouts the address benchmarks run on
+*/
+static std::vector<std::pair<std::string, boost::icl::interval_set<pointer>>> layouts() {
+  std::vector<std::pair<std::string, boost::icl::interval_set<pointer>>> layouts;
+  layouts.push_back({"contiguous", {}});
+
+  boost::icl::interval_set<pointer> pc;
+  pc += boost::icl::discrete_interval<pointer>::closed(0xa0000, 0xfffff);
+  pc += boost::icl::discrete_interval<pointer>::closed(0xc0000000, 0xffffffff);
+  layouts.push_back({"pc-holes", pc});
+
+  // Many small reserved ranges like on large servers
+  boost::icl::interval_set<pointer> fragmented = pc;
+  for (pointer hole = 1ULL << 20; hole < (1ULL << 34); hole += 1ULL << 26) {
+    fragmented += boost::icl::discrete_interval<pointer>::closed(hole, hole + 0xffff);
+  }
+  layouts.push_back({"fragmented", fragmented});
+  return layouts;
+}
+
+int main(int argc, char** argv) {
+  CLI::App app{"Unscatter framework microbenchmarks."};
+
+  std::string filter = "";
+  app.add_option("-f,--filter", filter, "Only run benchmarks containing this string");
+
+  size_t scale = 1;
+  app.add_option("-n,--scale", scale, "Multiply the operation count of every benchmark");
+
+  CLI11_PARSE(app, argc, argv);
+
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::warning, &consoleAppender);
+
+  std::vector<uint64_t> idx_vec = {6, 7, 9, 12, 13, 14, 16, 17, 18, 19, 21, 22, 24, 25, 26, 27, 28, 30, 31, 33};
+
+  for (auto& layout : layouts()) {
+    SimAddr addr(34, layout.second);
+
+    size_t ops = 100000 * scale;
+    run_bench(filter, "advance_bitmask_iterator/" + layout.first, ops,
+              [&] { addr.seed(BENCH_SEED); addr.init_bitmask_iterator(idx_vec); },
+              [&] {
+                for (size_t i = 0; i < ops; i++) {
+                  auto res = addr.advance_bitmask_iterator(1ULL << idx_vec[0]);
+                  asm volatile("" : : "r"(res.first));
+                }
+              });
+
+    ops = 1000000 * scale;
+    std::vector<pointer> candidates;
+    pcg64 rnd(BENCH_SEED);
+    for (size_t i = 0; i < ops; i++) {
+      candidates.push_back(rnd(1ULL << 34));
+    }
+    run_bench(filter, "valid_address/" + layout.first, ops, [] {},
+              [&] {
+                for (auto candidate : candidates) {
+                  bool valid = addr.valid_address(candidate);
+                  asm volatile("" : : "r"(valid));
+                }
+              });
+
+    run_bench(filter, "get_random_addr/" + layout.first, ops, [&] { addr.seed(BENCH_SEED); },
+              [&] {
+                for (size_t i = 0; i < ops; i++) {
+                  auto res = addr.get_random_addr();
+                  asm volatile("" : : "r"(res));
+                }
+              });
+
+    run_bench(filter, "get_flip_pair/" + layout.first, ops, [&] { addr.seed(BENCH_SEED); },
+              [&] {
+                for (size_t i = 0; i < ops; i++) {
+                  auto res = addr.get_flip_pair(6 + i % 28);
+                  asm volatile("" : : "r"(res.first));
+                }
+              });
+  }
+
+  {
+    size_t ops = 1000000 * scale;
+    run_bench(filter, "idx_from_idx_vec_and_addr", ops, [] {},
+              [&] {
+                for (size_t i = 0; i < ops; i++) {
+                  auto res = idx_from_idx_vec_and_addr(idx_vec, i << 6);
+                  asm volatile("" : : "r"(res));
+                }
+              });
+  }
+
+  {
+    size_t ops = 100000 * scale;
+    StubOracle oracle(10, 9, 0x1b5f575440);
+    run_bench(filter, "oracle_robust/stub", ops, [] {},
+              [&] {
+                for (size_t i = 0; i < ops; i++) {
+                  auto res = oracle.oracle_robust(i << 6, i << 6, 10);
+                  asm volatile("" : : "r"(res));
+                }
+              });
+  }
+
+  {
+    // Bimodal samples like a hit/miss timing distribution
+    std::vector<uint64_t> samples;
+    pcg64 rnd(BENCH_SEED);
+    for (size_t i = 0; i < 1000000 * scale; i++) {
+      samples.push_back((rnd(2) ? 180 : 60) + rnd(30));
+    }
+    run_bench(filter, "ostsu_treshold/1M", 1, [] {},
+              [&] {
+                auto res = ostsu_treshold(samples);
+                asm volatile("" : : "r"(res));
+              });
+  }
+
+  {
+    // Dump a nonlinear 14 bit function end to end in a scratch directory
+    auto scratch = std::filesystem::temp_directory_path() / ("unscatter-bench-" + std::to_string(getpid()));
+    std::filesystem::create_directories(scratch / "measurements");
+    auto cwd = std::filesystem::current_path();
+    std::filesystem::current_path(scratch);
+
+    std::istringstream function_text("x6*x7 + x9 + x12*x13*x14 + x16 + x17*x18 + x19 + x21*x22 + x24 + x25");
+    HashFunction function = HashFunction::parse(function_text);
+    size_t ops = (1ULL << function.relevant_bits(0).size());
+    BitwiseFramework<SimAddr, SimOracle>* framework = nullptr;
+    run_bench(filter, "dump_truth_table/sim-14bit", ops,
+              [&] {
+                delete framework;
+                auto addr = new SimAddr(34, boost::icl::interval_set<pointer>());
+                addr->seed(BENCH_SEED);
+                auto oracle = new SimOracle(10, 9, function, sim_noise{0, 0, 0, 0, 0, 0}, BENCH_SEED);
+                framework = new BitwiseFramework<SimAddr, SimOracle>(0, addr, oracle);
+                framework->output_classes = 2;
+                framework->bit_limit_hi = 64;
+                framework->bit_limit_lo = 0;
+                framework->input_space_bits = {function.relevant_bits(0)};
+                framework->input_space_linear = {false};
+              },
+              [&] { framework->dump_truth_table(); });
+    delete framework;
+
+    std::filesystem::current_path(cwd);
+    std::filesystem::remove_all(scratch);
+  }
+}
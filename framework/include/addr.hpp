@@ -12,14 +12,23 @@
 #include <random>
 #include <cmath>
 #include <map>
+#include <list>
+#include <unordered_map>
 #include <boost/icl/interval_set.hpp>
 
 #include "pcg_random.hpp"
+#include "numa.hpp"
 
 typedef uint64_t pointer;
 
 #define ADDR_RETRIES_INC 100000
 #define ADDR_RETRIES_RAND_SELECT 1000
+#define ADDR_NODE_REDRAWS 64 // redraws of an unmappable address that try to stay on the node of the previous one
+#define PHYS_WINDOW_COUNT 1024 // windows of /dev/mem that stay mapped at once
+#define PHYS_MIN_WINDOWS 6 // a pinned flip pair and the address an oracle maps next to it, each with its following page
+#define VIRT_USER_BITS 47 // width of user space virtual addresses with 4 level page tables
+#define VIRT_MIN_BITS 12 // virtual address spaces span at least one 4K page
+#define VIRT_FAULT_SLOTS (1 << 16) // alias pages remembered as faulted in, older ones are touched again
 
 /*
  * Contexts for the mappable dram ranges, it is used to work with physical
@@ -31,6 +40,16 @@ typedef struct dram_ctx {
   uint64_t max_address;
 } dram_ctx;
 
+dram_ctx get_ranges_dram_ctx(boost::icl::interval_set<uint64_t> ram_ranges);
+
+/*
+ * Pages backing the virtual address space, auto picks the largest pages the
+ * system offers
+ */
+enum virt_backing {VIRT_BACKING_AUTO, VIRT_BACKING_4K, VIRT_BACKING_THP, VIRT_BACKING_2M, VIRT_BACKING_1G};
+
+virt_backing parse_virt_backing(std::string name);
+
 
 /*
 * Interface to the get addresses
@@ -40,60 +59,148 @@ class IAddr {
   std::random_device rd; // seed the random number generator
   
  protected:
-  pcg64 rnd{rd()};
+  uint64_t rng_seed{((uint64_t)rd() << 32) | rd()};
+  pcg64 rnd{rng_seed};
   pointer bitmsask_iterator_position; // current position of the iterator
   uint64_t bitmask;
   std::vector<uint64_t> idx_vec;
   std::vector<uint64_t> idx_vec_invert;
+  uint64_t bitmask_invert; // bits of idx_vec_invert
+  uint64_t walk_mask; // bits of bitmask the iterator counts through, the others keep their value
+  pointer next_iterator_position(size_t step);
 
  public:
   size_t maxbits;
   std::pair<pointer, pointer> get_flip_pair(int idx);
-  void init_bitmask_iterator(std::vector<uint64_t> idx_vec);
-  pointer get_alternative_addr(pointer addr);
+  void init_bitmask_iterator(std::vector<uint64_t> idx_vec, pointer start = 0, uint64_t walk = ~0ULL);
+  virtual pointer get_alternative_addr(pointer addr);
+  void seed(uint64_t seed);
+  uint64_t get_seed();
   virtual std::pair<pointer,bool> advance_bitmask_iterator(size_t step) = 0;
   virtual bool valid_address(pointer address) = 0;
   virtual pointer get_random_addr() = 0;
   virtual pointer map_addr(pointer addr) = 0;
+  virtual pointer unmap_addr(pointer mapped) = 0;
   virtual pointer flip_unused_bits(pointer addr) = 0;
+  // Address pools that unmap addresses to make room keep pinned ones mapped
+  virtual void pin_addr(pointer) {}
+  virtual void unpin_addr(pointer) {}
+  virtual void reserve_mappings(size_t) {}
+  virtual ~IAddr() {}
 };
 
 /*
-* Addr class for physical addresses
+* Pins an address for the lifetime of the guard
 */
-class PhysAddr : public IAddr
+class AddrPin
 {
     private:
+      IAddr* addr;
+      pointer pinned;
+
+    public:
+      AddrPin(IAddr* addr, pointer pinned) : addr(addr), pinned(pinned) { addr->pin_addr(pinned); }
+      ~AddrPin() { this->addr->unpin_addr(this->pinned); }
+};
+
+/*
+* Addr class for addresses that are backed by a set of mappable ranges
+*/
+class RangeAddr : public IAddr
+{
+    protected:
       dram_ctx dram;
-      char* map_base;
-      
+      std::vector<numa_node> redraw_nodes; // nodes redraws try to stay on, empty to redraw anywhere
+      size_t redraw_node = 0; // node of the last address of the iterator
+      pointer redraw(pointer addr);
+      void follow_node(pointer addr);
+
     public:
       virtual std::pair<pointer,bool> advance_bitmask_iterator(size_t step);
       virtual bool valid_address(pointer addr);
       virtual pointer get_random_addr();
-      virtual pointer map_addr(pointer addr);
       virtual pointer flip_unused_bits(pointer addr);
+      virtual pointer get_alternative_addr(pointer addr);
+      void keep_nodes(const std::vector<numa_node>& nodes);
+      const dram_ctx& get_dram() const;
+};
+
+/*
+* Addr class for physical addresses
+*/
+class PhysAddr final : public RangeAddr
+{
+    private:
+      char* map_base;
+      size_t map_size;
+      int mem_fd;
+      size_t window_bits; // windows of 2^window_bits bytes are mapped on demand, 0 maps everything at once
+      size_t window_count; // maximum number of mapped windows
+      pointer last_window; // window of the last mapped address
+      std::list<pointer>::iterator last_window_lru; // entry of last_window in window_lru
+      std::list<pointer> window_lru; // mapped windows, most recently used first
+      std::unordered_map<pointer, std::list<pointer>::iterator> windows;
+      std::unordered_map<pointer, size_t> pinned_windows; // windows that are not evicted, with the number of pins
+      boost::icl::interval_set<pointer> uncachable_ranges; // physical ranges currently mapped uncachable
+      std::vector<numa_node> numa_nodes; // RAM ranges and cores of every NUMA node
+      void map_window(pointer window);
+      size_t apply_memory_type(pointer lower, pointer upper, int mt);
+      void switch_memory_type(const boost::icl::interval_set<pointer>& ranges, int mt);
+      
+    public:
+      virtual pointer map_addr(pointer addr);
+      virtual pointer unmap_addr(pointer mapped);
+      virtual void pin_addr(pointer addr);
+      virtual void unpin_addr(pointer addr);
+      virtual void reserve_mappings(size_t addrs);
       virtual void make_cachable();
       virtual void make_uncachable();
-      PhysAddr();
+      void make_cachable(pointer lower, pointer upper);
+      void make_uncachable(pointer lower, pointer upper);
+      const std::vector<numa_node>& get_numa_nodes() const;
+      PhysAddr(size_t window_bits = 0, size_t window_count = PHYS_WINDOW_COUNT);
       ~PhysAddr();
 };
 
+/*
+* Addr class for simulated physical addresses, the synthetic ram layout
+* contains holes like a real machine but nothing is mapped
+*/
+class SimAddr final : public RangeAddr
+{
+    public:
+      virtual pointer map_addr(pointer addr);
+      virtual pointer unmap_addr(pointer mapped);
+      SimAddr(size_t maxbits, boost::icl::interval_set<pointer> holes);
+      SimAddr(size_t maxbits, dram_ctx dram);
+      ~SimAddr();
+};
+
 /*
 * Addr class for virtual addresses
 */
-class VirtAddr : public IAddr
+class VirtAddr final : public IAddr
 {
     private:
       char* map_base;
+      size_t map_size;
+      virt_backing backing; // pages the mapping is backed by
+      int alias_fd; // memfd that is mapped repeatedly in aliased mode, -1 otherwise
+      size_t alias_size; // bytes of one alias
+      std::vector<pointer> faulted_pages; // direct mapped by page number, page + 1 of an alias page that has page table entries
+      char* map_backing(virt_backing backing, bool populate);
+      char* map_aliased(size_t alias_bits);
+      void log_tlb_misses();
 
     public:
       virtual std::pair<pointer,bool> advance_bitmask_iterator(size_t step);
       virtual bool valid_address(pointer addr);
       virtual pointer get_random_addr();
       virtual pointer map_addr(pointer addr);
+      virtual pointer unmap_addr(pointer mapped);
       virtual pointer flip_unused_bits(pointer addr);
-      VirtAddr(size_t maxbits);
+      VirtAddr(size_t maxbits, bool backed = true, virt_backing backing = VIRT_BACKING_AUTO, bool populate = true,
+               size_t alias_bits = 0);
       ~VirtAddr();
 };
 
@@ -0,0 +1,37 @@
+#ifndef _CONSENSUS_H_
+#define _CONSENSUS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "truth-table.hpp"
+
+#define CONSENSUS_DISPUTE 0.25 // entries whose losing votes hold at least this share of the weight are disputed
+
+/*
+ * Entry whose votes disagree too much to trust the consensus
+ */
+typedef struct disputed_entry {
+  uint64_t index;
+  uint64_t value; // class the consensus picked
+  uint64_t agree; // weight of the votes for value
+  uint64_t total; // weight of all votes
+} disputed_entry;
+
+/*
+ * Summary of a consensus over several runs
+ */
+typedef struct consensus_stats {
+  uint64_t unanimous; // entries all votes agree on
+  uint64_t contested; // entries with disagreeing votes
+  uint64_t disputed; // contested entries with a small margin
+  uint64_t unvoted; // entries no run measured
+} consensus_stats;
+
+consensus_stats consensus_bitwise(const std::vector<truth_table>& runs, const std::vector<unsigned>& weights,
+                                  double dispute, truth_table& out, std::vector<disputed_entry>& disputed);
+consensus_stats consensus_classes(const std::vector<truth_table>& runs, const std::vector<unsigned>& weights,
+                                  double dispute, truth_table& out, std::vector<disputed_entry>& disputed);
+void align_run_labels(const truth_table& reference, truth_table& run);
+
+#endif
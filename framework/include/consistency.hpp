@@ -0,0 +1,31 @@
+#ifndef _CONSISTENCY_H_
+#define _CONSISTENCY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define CONSISTENCY_STRUCTURE_THRESHOLD 0.125 // derivatives violated less often than this are treated as structure
+
+/*
+ * Truth table of one output bit over vars variables, entry x is bit x
+ */
+typedef std::vector<uint64_t> bit_table;
+
+/*
+ * Structure of a function that a few noisy entries cannot hide
+ */
+typedef struct table_structure {
+  std::vector<std::pair<size_t, bool>> linear; // variables with a constant derivative and its value
+  std::vector<std::pair<size_t, size_t>> separable; // variable pairs whose second derivative vanishes
+} table_structure;
+
+bit_table make_bit_table(size_t vars);
+bool get_entry(const bit_table& table, uint64_t x);
+void set_entry(bit_table& table, uint64_t x, bool value);
+table_structure find_structure(const bit_table& table, const bit_table& known, size_t vars);
+std::vector<uint64_t> find_inconsistent(const bit_table& table, const bit_table& known, size_t vars,
+                                        const table_structure& structure);
+
+#endif
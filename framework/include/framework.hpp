@@ -3,6 +3,12 @@
 
 #include "../include/addr.hpp"
 #include "../include/oracle.hpp"
+#include "../include/housekeeping.hpp"
+#include "../include/tiling.hpp"
+#include "../include/shard.hpp"
+#include "../include/numa.hpp"
+#include "../include/pla.hpp"
+#include "../include/hash-function.hpp"
 
 typedef uint64_t pointer;
 
@@ -11,18 +17,29 @@ typedef uint64_t pointer;
  * hash functions
  */
 class Framework {
- protected:
-  Oracle* oracle; // Oracle used for measuremnts
-  IAddr* addr; // Address pool to measure on 
-
  public:
   uint64_t bit_limit_hi; // lowest considered bit
   uint64_t bit_limit_lo; // highest considered bit
-  uint64_t output_classes; // number of output classes
+  uint64_t output_classes = 0; // number of output classes
+  std::string output_dir = "measurements"; // directory the results are written to
+  bool owns_addr = true; // false if the address pool is shared with other frameworks
+  bool two_pass = false; // measure cheaply first and robustly only where the table is inconsistent
+  int first_pass_calls = 1; // oracle calls per entry in the cheap pass
+  bool tile = false; // dump every assignment of the relevant bits outside the limits as its own table
+  std::unique_ptr<TileManifest> manifest; // tiles written by the dump if tile is set
+  shard_spec shard{0, 1}; // part of every table that is dumped
+  std::shared_ptr<NumaScheduler> numa; // moves measurements to a core local to the node of the address if set
+  pla_spec pla{false, false, 0}; // espresso input written next to every dump
+  bool labelled = false; // the oracle returns relabelled class codes, not the hash
   virtual void determine_output_classes() = 0;
   virtual void get_input_space_bits() = 0;
   virtual void dump_truth_table() = 0;
   virtual void dry_run() = 0;
+  // Frameworks over several oracles have no single function to verify, main rejects them
+  virtual bool verify(const HashFunction&, size_t) {
+    std::throw_with_nested(std::runtime_error("Verification is not supported by this framework"));
+  }
+  virtual ~Framework() {}
 
   std::vector<std::vector<uint64_t>> input_space_bits;
   std::vector<bool> input_space_linear;
@@ -32,28 +49,71 @@ class Framework {
 /*
 * Decompose the function into bitwise parts, saving on the ammount of measuremnts that neeed to be performend
 * Requires that the used oracle is a direct one
+* The address pool and oracle types are fixed at compile time so the hot loops
+* call them directly, IAddr and Oracle accept any address pool and oracle
 */
+template <typename AddrT = IAddr, typename OracleT = Oracle>
 class BitwiseFramework : public Framework{
+  protected:
+   AddrT* addr; // Address pool to measure on
+   OracleT* oracle; // Oracle used for measuremnts
+   uint64_t measure_robust(pointer mapped_addr, pointer select_addr);
+   void dump_bit_two_pass(size_t bit_idx, const std::vector<uint64_t>& bit_idx_reduce, size_t iterations,
+                          pointer fixed, std::vector<bool>& seen_idx, DumpWriter& dumpfile);
+
   public:
    void determine_output_classes();
    void get_input_space_bits();
    void dump_truth_table();
    void dry_run();
-   BitwiseFramework(int core, IAddr* addr, Oracle* oracle);
+   bool verify(const HashFunction& function, size_t samples);
+   BitwiseFramework(int core, AddrT* addr, OracleT* oracle);
    ~BitwiseFramework();
 };
 
 /*
 * Naive implementation that measures all bits at once
 */
+template <typename AddrT = IAddr, typename OracleT = Oracle>
 class NaiveFramework : public Framework{
+  protected:
+   AddrT* addr; // Address pool to measure on
+   OracleT* oracle; // Oracle used for measuremnts
+   uint64_t measure_robust(pointer mapped_addr, pointer select_addr);
+   void dump_anchors(const std::vector<uint64_t>& bit_idx_reduce, pointer fixed, size_t iterations, std::string path);
+
   public:
    void determine_output_classes();
    void get_input_space_bits();
    void dump_truth_table();
    void dry_run();
-   NaiveFramework(int core, IAddr* addr, Oracle* oracle);
+   bool verify(const HashFunction& function, size_t samples);
+   NaiveFramework(int core, AddrT* addr, OracleT* oracle);
    ~NaiveFramework();
 };
 
-#endif
\ No newline at end of file
+/*
+* Runs several oracles on one shared address pool. The relevant bits of all
+* functions are enumerated in a single walk and every address is measured by
+* the oracles whose tables need it.
+*/
+class MultiFramework : public Framework{
+  protected:
+   IAddr* addr; // Address pool shared by all frameworks
+   std::vector<Framework*> frameworks; // One framework per oracle, they find the relevant bits
+   std::vector<Oracle*> oracles;
+   std::vector<bool> naive;
+   void propagate_settings();
+   uint64_t measure_robust(Oracle* oracle, pointer mapped_addr, pointer select_addr);
+
+  public:
+   void add(Framework* framework, Oracle* oracle, bool naive);
+   void determine_output_classes();
+   void get_input_space_bits();
+   void dump_truth_table();
+   void dry_run();
+   MultiFramework(IAddr* addr);
+   ~MultiFramework();
+};
+
+#endif
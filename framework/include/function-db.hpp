@@ -0,0 +1,45 @@
+#ifndef _FUNCTION_DB_H_
+#define _FUNCTION_DB_H_
+
+#include <cstdint>
+#include <string>
+
+#include "hash-function.hpp"
+
+#define FUNCTION_DB_EXTENSION ".fn"
+#define FUNCTION_DB_FILE "function.fn" // function verified from the database, below the output directory
+#define FUNCTION_DB_SYSFS_CPUS "/sys/devices/system/cpu"
+#define FUNCTION_DB_SYSFS_PMUS "/sys/bus/event_source/devices"
+
+/*
+ * Identifies machines that share their hash functions: the CPUID vendor and
+ * signature, the physical cores and sockets, the uncore boxes (one per slice)
+ * and the framework that recovers the function
+ */
+std::string function_db_key(int set, bool xeon);
+
+/*
+ * A function of the database together with what the recovery measured
+ */
+typedef struct function_db_entry {
+  HashFunction function;
+  uint64_t output_classes;
+  std::string path;
+} function_db_entry;
+
+/*
+ * Local database of recovered functions, one function file per key. The
+ * entries are plain function files, their metadata is kept in comments.
+ */
+class FunctionDb {
+ private:
+  std::string dir;
+
+ public:
+  FunctionDb(std::string dir);
+  bool lookup(std::string key, function_db_entry& entry);
+  void store(std::string key, const HashFunction& function, uint64_t output_classes);
+  static void write(std::string path, std::string key, const HashFunction& function, uint64_t output_classes);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _HASH_FUNCTION_H_
+#define _HASH_FUNCTION_H_
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef uint64_t pointer;
+
+#define HASH_FUNCTION_MAX_EXPRESSION_VARIABLES 28 // variables of an expression that is converted to anf
+
+/*
+ * A single output bit in algebraic normal form. The linear part is kept as a
+ * xor mask, every nonlinear monomial as the mask of the variables that are
+ * and-ed together.
+ */
+typedef struct anf_bit {
+  uint64_t linear;
+  std::vector<uint64_t> monomials;
+  bool constant;
+} anf_bit;
+
+/*
+ * Token of an expression in reverse polish notation, op is one of & ^ | ~,
+ * v for the variable or c for the constant in value
+ */
+typedef struct expression_token {
+  char op;
+  uint64_t value;
+} expression_token;
+
+typedef std::vector<expression_token> expression;
+
+/*
+ * Hash function given as one xor mask or anf expression per output bit.
+ * Lines of a function file are either a mask like 0x1b5f575440 or an anf
+ * like x6*x7 + x8 + 1, empty lines and lines starting with # are skipped.
+ * Lines with ~, | or parentheses are boolean expressions with python
+ * precedence like (x6 & x7) ^ ~x8, they are converted to anf.
+ * Files ending in .sol are solutions of the minimizer for bit_<n>, their
+ * variable x[i] is the i-th relevant bit of line n of bits.csv next to them.
+ */
+class HashFunction {
+ public:
+  std::vector<anf_bit> bits;
+  int64_t output_bit = -1; // output bit a bit_<n>.sol of the minimizer describes, -1 for whole functions
+  uint64_t eval(pointer addr) const;
+  uint64_t eval_bit(size_t bit, pointer addr) const;
+  std::vector<uint64_t> relevant_bits(size_t bit) const;
+  bool is_linear() const;
+  static anf_bit parse_bit(std::string line);
+  static std::string format_bit(const anf_bit& bit);
+  static expression parse_expression(std::string text, const std::vector<uint64_t>& bits = {},
+                                     const std::map<std::string, expression>& names = {});
+  static anf_bit expression_to_anf(const expression& expr);
+  static HashFunction parse(std::istream& in);
+  static HashFunction parse_solution(std::istream& in, const std::vector<uint64_t>& bits);
+  HashFunction();
+  HashFunction(std::string path);
+};
+
+#endif
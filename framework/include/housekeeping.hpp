@@ -0,0 +1,251 @@
+#ifndef _HOUSEKEEPING_H_
+#define _HOUSEKEEPING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+#include <immintrin.h>
+#include <plog/Log.h>
+
+#include "metrics.hpp"
+#include "truth-table.hpp"
+
+typedef uint64_t pointer;
+
+#define HOUSEKEEPING_RING_RECORDS (1 << 16) // records buffered between measurement and writer thread
+#define HOUSEKEEPING_BATCH_BYTES (1 << 20) // bytes collected before a write
+#define HOUSEKEEPING_MAX_RECORD_BYTES 256 // upper bound for one formatted record
+#define HOUSEKEEPING_IDLE_US 200 // sleep of the writer thread if there is nothing to write
+
+/*
+ * Writer with a housekeeping thread that has to be drained before the process
+ * ends
+ */
+class HousekeepingWriter {
+ public:
+  virtual void close() = 0;
+  virtual ~HousekeepingWriter() {}
+};
+
+/*
+ * Places threads that do I/O, logging and reporting away from the core the
+ * measurements run on. Writers that are still open when the process exits are
+ * drained, so records are kept on the exit paths of fatal errors.
+ */
+class Housekeeping {
+ private:
+  static int measurement_core;
+  static int housekeeping_core;
+  static std::mutex writers_lock;
+  static std::vector<HousekeepingWriter*> writers;
+  static std::atomic<uint64_t> failed_writes;
+  static void close_writers();
+
+ public:
+  static void set_cores(int measurement_core, int housekeeping_core);
+  static void pin();
+  static void register_writer(HousekeepingWriter* writer);
+  static void unregister_writer(HousekeepingWriter* writer);
+  static void write_failed() { failed_writes.fetch_add(1, std::memory_order_relaxed); }
+  static uint64_t write_failures() { return failed_writes.load(std::memory_order_relaxed); }
+};
+
+/*
+ * Lock free ring between exactly one producer and one consumer thread
+ */
+template <typename T, size_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "Ring capacity has to be a power of two");
+
+ private:
+  alignas(64) std::atomic<size_t> head{0}; // next slot the producer writes
+  alignas(64) std::atomic<size_t> tail{0}; // next slot the consumer reads
+  alignas(64) T slots[N];
+
+ public:
+  bool push(const T& item) {
+    auto h = this->head.load(std::memory_order_relaxed);
+    if (h - this->tail.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    this->slots[h & (N - 1)] = item;
+    this->head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item) {
+    auto t = this->tail.load(std::memory_order_relaxed);
+    if (t == this->head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = this->slots[t & (N - 1)];
+    this->tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+/*
+ * Writes fixed size records to a file from a housekeeping thread, the
+ * measurement thread only copies records into a ring. If the ring is full the
+ * producer waits for the writer. A failed write is reported once and the
+ * records after it are dropped, the process then exits with an error.
+ */
+template <typename T>
+class RingWriter : public HousekeepingWriter {
+ public:
+  typedef size_t (*formatter)(char* out, const T& item); // formats at most HOUSEKEEPING_MAX_RECORD_BYTES
+
+ private:
+  std::string path;
+  std::ofstream file;
+  std::string footer;
+  formatter format;
+  std::unique_ptr<SpscRing<T, HOUSEKEEPING_RING_RECORDS>> ring;
+  std::atomic<bool> stopped;
+  bool failed;
+  std::thread thread;
+
+  void write(const char* data, size_t size) {
+    if (this->failed) {
+      return;
+    }
+    if (!this->file.write(data, size)) {
+      this->failed = true;
+      Housekeeping::write_failed();
+      PLOG_ERROR << "Writing " << this->path << " failed: " << std::strerror(errno);
+    }
+  }
+
+  void run() {
+    Housekeeping::pin();
+    std::vector<char> batch(HOUSEKEEPING_BATCH_BYTES + HOUSEKEEPING_MAX_RECORD_BYTES);
+    size_t used = 0;
+    T item;
+    while (true) {
+      bool stop = this->stopped.load(std::memory_order_acquire);
+      bool popped = false;
+      while (this->ring->pop(item)) {
+        popped = true;
+        used += this->format(batch.data() + used, item);
+        if (used >= HOUSEKEEPING_BATCH_BYTES) {
+          this->write(batch.data(), used);
+          used = 0;
+        }
+      }
+      if (popped) {
+        continue;
+      }
+      // Ring is drained, write what is left instead of holding it back
+      if (used) {
+        this->write(batch.data(), used);
+        used = 0;
+      }
+      if (stop) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(HOUSEKEEPING_IDLE_US));
+    }
+    this->write(this->footer.data(), this->footer.size());
+    if (!this->failed && !this->file.flush()) {
+      this->failed = true;
+      Housekeeping::write_failed();
+      PLOG_ERROR << "Flushing " << this->path << " failed: " << std::strerror(errno);
+    }
+  }
+
+ public:
+  RingWriter(std::string path, std::string header, formatter format, std::string footer = "")
+      : ring(new SpscRing<T, HOUSEKEEPING_RING_RECORDS>()) {
+    this->path = path;
+    this->format = format;
+    this->footer = footer;
+    this->stopped = false;
+    this->failed = false;
+    this->file.open(path, std::ios::binary);
+    if (!this->file.is_open()) {
+      std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+    }
+    this->write(header.data(), header.size());
+    this->thread = std::thread(&RingWriter::run, this);
+    Housekeeping::register_writer(this);
+  }
+
+  void push(const T& item) {
+    if (this->ring->push(item)) {
+      return;
+    }
+    Metrics::add(COUNTER_IO_STALLS);
+    while (!this->ring->push(item)) {
+      _mm_pause();
+    }
+  }
+
+  /*
+   * Writes all pushed records and the footer, called by the producer or when
+   * the process exits
+   */
+  void close() {
+    if (!this->thread.joinable()) {
+      return;
+    }
+    this->stopped.store(true, std::memory_order_release);
+    this->thread.join();
+    Housekeeping::unregister_writer(this);
+  }
+
+  ~RingWriter() { this->close(); }
+};
+
+/*
+ * Truth table entry as it is written to the csv dumps
+ */
+typedef struct dump_record {
+  pointer addr;
+  uint64_t value;
+  bool mapped; // unmapped entries are written as don't care
+  uint32_t margin; // votes of the class minus those of the runner up in percent
+} dump_record;
+
+size_t format_dump_record(char* out, const dump_record& record);
+
+/*
+ * Log appender that hands records to a housekeeping thread, which formats and
+ * prints them. Errors are written synchronously as they usually precede an exit.
+ */
+class AsyncLogAppender : public plog::IAppender {
+ private:
+  typedef struct log_entry {
+    plog::Severity severity;
+    const char* func;
+    size_t line;
+    const char* file;
+    const void* object;
+    int instance;
+    std::string message;
+  } log_entry;
+
+  plog::IAppender* next;
+  std::deque<log_entry> queue;
+  bool stopped;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::thread thread;
+  void run();
+  void forward(const log_entry& entry);
+
+ public:
+  AsyncLogAppender(plog::IAppender* next);
+  ~AsyncLogAppender();
+  virtual void write(const plog::Record& record);
+};
+
+#endif
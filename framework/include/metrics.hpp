@@ -0,0 +1,146 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include <mutex>
+#include <memory>
+
+#define METRICS_MAX_BITS 64 // output bits tracked separately, one more slot counts work without a bit
+#define METRICS_BIT_SLOTS (METRICS_MAX_BITS + 1)
+#define METRICS_HIST_SUB_BITS 4 // 16 linear sub buckets per power of two
+#define METRICS_HIST_BUCKETS 1024
+
+/*
+ * Phases of a run, every metric is accounted to the phase of its thread
+ */
+enum metrics_phase {
+  PHASE_SETUP,
+  PHASE_OUTPUT_CLASSES,
+  PHASE_INPUT_SPACE,
+  PHASE_DUMP,
+  PHASE_DRY_RUN,
+  PHASE_VERIFY,
+  PHASE_COUNT
+};
+
+enum metrics_counter {
+  COUNTER_ORACLE_CALLS, // raw oracle calls
+  COUNTER_DECISIONS, // robust oracle decisions
+  COUNTER_RETRIES, // remeasures of robust decisions
+  COUNTER_EXCEPTIONS, // robust decisions that exceeded their retries
+  COUNTER_ENTRIES, // truth table entries
+  COUNTER_UNMAPPABLE, // addresses that could not be mapped
+  COUNTER_FLAGGED, // entries remeasured robustly after the cheap pass
+  COUNTER_ADDR_NS, // time spent selecting addresses
+  COUNTER_ORACLE_NS, // time spent in the oracle
+  COUNTER_IO_NS, // time spent writing results
+  COUNTER_IO_STALLS, // writes that waited for the writer thread
+  COUNTER_RECALIBRATIONS, // thresholds moved after timing drift
+  COUNTER_WEAK_ACCEPTS, // robust decisions accepted below the confidence
+  COUNTER_UNLABELLED, // oracle responses with a class the relabelling did not learn
+  COUNTER_WALL_NS, // wall time of the phase
+  COUNTER_COUNT
+};
+
+enum metrics_histogram {
+  HIST_ORACLE_NS, // mean latency of the oracle calls of one round
+  HIST_VOTES, // oracle calls needed for one robust decision
+  HIST_COUNT
+};
+
+/*
+ * Metrics of a single thread, only the owning thread writes, exporters read
+ */
+typedef struct metrics_shard {
+  std::atomic<uint64_t> counters[PHASE_COUNT][METRICS_BIT_SLOTS][COUNTER_COUNT];
+  std::atomic<uint64_t> histograms[PHASE_COUNT][HIST_COUNT][METRICS_HIST_BUCKETS];
+} metrics_shard;
+
+/*
+ * Metrics summed over all threads
+ */
+typedef struct metrics_totals {
+  uint64_t counters[PHASE_COUNT][METRICS_BIT_SLOTS][COUNTER_COUNT];
+  uint64_t histograms[PHASE_COUNT][HIST_COUNT][METRICS_HIST_BUCKETS];
+} metrics_totals;
+
+/*
+ * Counters and histograms of the calling thread in one phase and bit. Hot
+ * loops resolve it once and update it inline.
+ */
+typedef struct metrics_slot {
+  std::atomic<uint64_t>* counters;
+  std::atomic<uint64_t> (*histograms)[METRICS_HIST_BUCKETS];
+  void add(metrics_counter counter, uint64_t value = 1) {
+    auto& c = this->counters[counter];
+    c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+  void record(metrics_histogram histogram, uint64_t value);
+} metrics_slot;
+
+/*
+ * Registry of per thread counters and log linear latency histograms
+ */
+class Metrics {
+ private:
+  static metrics_shard* shard();
+  static std::unique_ptr<metrics_totals> sum_shards();
+
+ public:
+  static void set_phase(metrics_phase phase);
+  static void set_bit(int bit);
+  static metrics_slot slot();
+  static void add(metrics_counter counter, uint64_t value = 1);
+  static void record(metrics_histogram histogram, uint64_t value);
+  static uint64_t total(metrics_counter counter);
+  static size_t bucket(uint64_t value);
+  static uint64_t bucket_value(size_t bucket);
+  static void write_json(std::string path);
+  static void write_textfile(std::string path);
+};
+
+inline void metrics_slot::record(metrics_histogram histogram, uint64_t value) {
+  auto& h = this->histograms[histogram][Metrics::bucket(value)];
+  h.store(h.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*
+ * Adds the lifetime of the timer in ns to a counter
+ */
+class MetricsTimer {
+ private:
+  metrics_counter counter;
+  std::chrono::steady_clock::time_point start;
+
+ public:
+  MetricsTimer(metrics_counter counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+  uint64_t elapsed() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  ~MetricsTimer() { Metrics::add(counter, elapsed()); }
+};
+
+/*
+ * Background thread that periodically rewrites the metrics textfile
+ */
+class MetricsExporter {
+ private:
+  std::string path;
+  unsigned interval;
+  bool stopped;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::thread thread;
+  void run();
+
+ public:
+  MetricsExporter(std::string path, unsigned interval);
+  ~MetricsExporter();
+};
+
+#endif
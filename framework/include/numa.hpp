@@ -0,0 +1,53 @@
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/icl/interval_set.hpp>
+
+typedef uint64_t pointer;
+
+#define NUMA_SYSFS_NODES "/sys/devices/system/node"
+#define NUMA_SYSFS_BLOCK_SIZE "/sys/devices/system/memory/block_size_bytes"
+#define NUMA_STATS_FILE "numa.csv" // per node statistics, below the output directory
+
+/*
+ * Physical memory and cores of a NUMA node
+ */
+typedef struct numa_node {
+  int node;
+  boost::icl::interval_set<pointer> ram_ranges; // RAM ranges that belong to the node
+  std::vector<int> cpus;
+} numa_node;
+
+std::vector<numa_node> get_numa_nodes(const boost::icl::interval_set<pointer>& ram_ranges);
+
+/*
+ * Moves the measurement thread to a core local to the node of the address that
+ * is measured next, so remote accesses do not add latency and noise
+ */
+class NumaScheduler {
+ private:
+  typedef struct node_stats {
+    uint64_t entries;
+    uint64_t cycles; // cycles between the scheduling of an entry and the next one
+  } node_stats;
+
+  std::vector<numa_node> nodes;
+  std::vector<int> node_core; // core the entries of a node are measured on, -1 to stay where we are
+  std::vector<node_stats> stats; // one more slot for addresses outside of all nodes
+  boost::icl::discrete_interval<pointer> current_range; // range of the current node, a lookup is only needed outside of it
+  size_t current_node;
+  int current_core;
+  uint64_t last_tsc;
+  uint64_t migrations;
+  size_t find_node(pointer addr);
+
+ public:
+  NumaScheduler(std::vector<numa_node> nodes, int core, int housekeeping_core);
+  void schedule(pointer addr);
+  void report(std::string output_dir);
+};
+
+#endif
@@ -1,10 +1,19 @@
 #ifndef _ORACLE_H_
 #define _ORACLE_H_
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <vector>
+#include <unordered_map>
+#include <stdexcept>
 
 #include "addr.hpp"
+#include "hash-function.hpp"
+#include "trace.hpp"
+#include "housekeeping.hpp"
+#include "threshold.hpp"
+#include "metrics.hpp"
 
 #define MAX_OUTPUT_CLASS_ASSUMPTION 100
 
@@ -17,17 +26,66 @@ typedef uint64_t pointer;
 class Oracle
 {
     private: 
+        std::vector<uint64_t> hist; // votes of oracle_robust, reused between calls
     public:
         int runs;
         int confidence;
+        int weak_confidence = 0; // votes that are accepted without retrying if confidence is not reached, 0 disables
+        uint32_t margin();
+        uint32_t bit_margin(size_t bit);
         int precision; // precision parameter that can be used to tweak oracle
+        // OracleT is the concrete type of this oracle, with a final class the oracle is called directly
+        template <typename OracleT = Oracle>
         uint64_t oracle_robust(pointer addr, pointer paddr, int retries);
+        template <typename OracleT = Oracle>
+        uint64_t timed_oracle(pointer addr);
+        template <typename OracleT = Oracle, typename Vote>
+        void timed_round(pointer addr, int calls, Vote vote);
         virtual uint64_t oracle(pointer addr) = 0;
         uint64_t output_classes;
         Oracle(int runs,int confidence);
+        virtual ~Oracle() {}
 };
 
-class SliceOracle : public Oracle
+/*
+* Round of oracle calls for one address that is accounted in the metrics as a
+* whole, the clock is read and the metrics of the thread are resolved once per
+* round instead of once per call
+*/
+template <typename OracleT, typename Vote>
+void Oracle::timed_round(pointer addr, int calls, Vote vote){
+  auto slot = Metrics::slot();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++)
+  {
+    vote(static_cast<OracleT*>(this)->oracle(addr));
+  }
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  slot.add(COUNTER_ORACLE_CALLS, calls);
+  slot.add(COUNTER_ORACLE_NS, ns);
+  slot.record(HIST_ORACLE_NS, calls ? ns / calls : 0);
+}
+
+/*
+* Thrown if an oracle cannot answer for an address at all, retrying is pointless
+*/
+class OracleMiss : public std::runtime_error
+{
+    public:
+        OracleMiss(const std::string& what) : std::runtime_error(what) {}
+};
+
+/*
+* Thrown if a single oracle response cannot be used, the robust measurement
+* discards the round it belongs to and measures again
+*/
+class OracleNoise : public std::runtime_error
+{
+    public:
+        OracleNoise(const std::string& what) : std::runtime_error(what) {}
+};
+
+class SliceOracle final : public Oracle
 {
 private:
     bool is_xeon;
@@ -43,7 +101,7 @@ public:
     uint64_t oracle(pointer addr);
 };
 
-class UtagOracle : public Oracle
+class UtagOracle final : public Oracle
 {
 private:
     std::vector<std::vector<pointer>> class_examples;
@@ -58,12 +116,13 @@ public:
     uint64_t oracle(pointer addr);
 };
 
-class DramaOracle : public Oracle
+class DramaOracle final : public Oracle
 {
 private:
     std::vector<std::vector<pointer>> class_examples;
     IAddr* addr;
     size_t threshold;
+    std::unique_ptr<StreamingThreshold> estimator; // follows drift of the threshold, fed by every timing
     size_t num_reads = 5000;
     bool weak_drama_oracle(void* address1, void* address2, size_t threshold);
     void build_oracle();
@@ -76,11 +135,12 @@ public:
     uint64_t oracle(pointer addr);
 };
 
-class SliceTimingOracle : public Oracle
+class SliceTimingOracle final : public Oracle
 {
 private:
     IAddr* addr;
     size_t threshold;
+    std::unique_ptr<StreamingThreshold> estimator; // follows drift of the threshold, fed by every timing
     int cores;
     void determine_treshold();
     
@@ -90,5 +150,87 @@ public:
     uint64_t oracle(pointer addr);
 };
 
+/*
+* Noise model of the simulated oracle
+*/
+typedef struct sim_noise {
+    double flip_probability; // probability that a single output bit is flipped
+    double burst_probability; // probability that a burst of errors starts on a call
+    size_t burst_length; // number of calls a burst lasts
+    double burst_flip_probability; // flip probability while in a burst
+    double drift; // increase of the flip probability per million calls
+    uint64_t latency_ns; // time each call takes
+} sim_noise;
+
+class SimOracle final : public Oracle
+{
+private:
+    HashFunction function;
+    sim_noise noise;
+    pcg64 rnd;
+    uint64_t calls;
+    size_t burst_left;
+    bool flip(double probability);
+
+public:
+    SimOracle(int runs,int confidence,HashFunction function,sim_noise noise,uint64_t seed);
+    ~SimOracle();
+    uint64_t oracle(pointer addr);
+};
+
+/*
+* Wraps an oracle and writes every raw response to a trace file
+*/
+class RecordingOracle final : public Oracle
+{
+private:
+    Oracle* inner;
+    IAddr* addr;
+    std::unique_ptr<RingWriter<trace_record>> trace;
+
+public:
+    RecordingOracle(Oracle* inner,IAddr* addr,std::string path,bool naive);
+    ~RecordingOracle();
+    uint64_t oracle(pointer addr);
+};
+
+#define LABEL_PAIRS_PER_BIT 16 // flip pairs measured per address bit to learn the class transitions
+#define LABEL_MAX_CONFLICT_SHARE 0.05 // share of transitions that may contradict the learned codes as noise
+#define LABEL_RETRIES 100 // retries of the robust measurements while learning
+
+/*
+* Wraps an indirect oracle and answers with a binary code instead of the class
+* label. If the function is linear, flipping an address bit xors the hash with
+* the same value everywhere, so the labels form a group under the flips. The
+* codes follow that group: every output bit of a code is a linear function of
+* the address and can be dumped by the bitwise framework.
+*/
+class LabelledOracle final : public Oracle
+{
+private:
+    Oracle* inner;
+    std::unordered_map<uint64_t,uint64_t> codes; // binary code of every class label of the inner oracle
+
+public:
+    LabelledOracle(Oracle* inner,IAddr* addr);
+    ~LabelledOracle();
+    uint64_t oracle(pointer addr);
+};
+
+/*
+* Answers with the responses of a recorded trace, the n-th call for an address
+* gets the n-th recorded response for it
+*/
+class ReplayOracle final : public Oracle
+{
+private:
+    std::unordered_map<pointer,std::vector<uint32_t>> responses;
+    std::unordered_map<pointer,size_t> position;
+
+public:
+    ReplayOracle(int runs,int confidence,trace_header header,std::vector<trace_record> records);
+    ~ReplayOracle();
+    uint64_t oracle(pointer addr);
+};
 
 #endif
@@ -0,0 +1,87 @@
+#ifndef _PLA_H_
+#define _PLA_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "housekeeping.hpp"
+
+#define PLA_EXTENSION ".pla"
+#define PLA_MAX_INPUTS 64
+#define PLA_MAX_OUTPUTS 128
+
+/*
+ * Encodings of the outputs of a PLA. A bitwise table has a single output,
+ * tables of all output bits have one output per class (one hot) or per bit of
+ * the class (binary), so espresso can share terms between the outputs.
+ */
+enum pla_encoding {
+  PLA_SINGLE,
+  PLA_ONE_HOT,
+  PLA_BINARY
+};
+
+/*
+ * One cube of a PLA, formatted by the writer thread
+ */
+typedef struct pla_record {
+  uint64_t cube; // bit i is the i-th relevant bit of the address
+  uint64_t value; // output bit or class
+  uint8_t inputs;
+  uint8_t outputs;
+  uint8_t encoding;
+  bool care; // false writes all outputs as don't care
+} pla_record;
+
+size_t format_pla_record(char* out, const pla_record& record);
+
+/*
+ * Writes a truth table as espresso input with explicit on and off sets.
+ * Unmapped entries and entries below the minimum margin are don't cares.
+ */
+class PlaWriter {
+ private:
+  std::vector<uint64_t> bits;
+  uint8_t outputs;
+  pla_encoding encoding;
+  uint32_t min_margin;
+  std::unique_ptr<RingWriter<pla_record>> writer;
+
+ public:
+  PlaWriter(std::string path, const std::vector<uint64_t>& bits, pla_encoding encoding, uint64_t classes,
+            uint32_t min_margin, uint64_t bit = 0);
+  void push(const dump_record& record);
+};
+
+/*
+ * Output settings of the PLAs written next to the dumps
+ */
+typedef struct pla_spec {
+  bool enabled;
+  bool binary; // binary instead of one hot outputs for tables of all output bits
+  uint32_t min_margin; // entries below this margin are don't cares
+} pla_spec;
+
+/*
+ * Writes a dump and, if enabled, the PLA of the same table. bit is the output
+ * bit of a bitwise table, -1 for a table of all output bits.
+ */
+class DumpWriter {
+ private:
+  RingWriter<dump_record> csv;
+  std::unique_ptr<PlaWriter> pla;
+
+ public:
+  DumpWriter(std::string path, const pla_spec& spec, const std::vector<uint64_t>& bits, int64_t bit,
+             uint64_t classes = 0);
+  inline void push(const dump_record& record) {
+    this->csv.push(record);
+    if (this->pla) {
+      this->pla->push(record);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _PROGRESS_H_
+#define _PROGRESS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <condition_variable>
+#include <mutex>
+
+#define PROGRESS_EWMA_ALPHA 0.3 // weight of the newest rate sample
+
+/*
+ * Progress of the truth table dump, the measurement loop only increments an
+ * atomic counter, all formatting happens in the ProgressReporter thread
+ */
+class Progress {
+ public:
+  static std::atomic<uint64_t> done; // entries finished in the whole run
+  static std::atomic<uint64_t> run_total; // entries of the whole run
+  static std::atomic<uint64_t> table_start; // value of done when the current table started
+  static std::atomic<uint64_t> table_total; // entries of the current table
+  static std::atomic<int> table_bit; // output bit of the current table, -1 for all bits
+
+  static void begin_run(uint64_t entries);
+  static void begin_table(int bit, uint64_t entries);
+
+  /*
+   * Called once per entry by the measurement thread
+   */
+  static inline void advance() { done.store(done.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+};
+
+/*
+ * Background thread that samples the progress counters and reports rates and
+ * EWMA smoothed ETAs
+ */
+class ProgressReporter {
+ private:
+  unsigned interval;
+  bool stopped;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::thread thread;
+  void run();
+
+ public:
+  ProgressReporter(unsigned interval);
+  ~ProgressReporter();
+};
+
+#endif
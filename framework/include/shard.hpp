@@ -0,0 +1,29 @@
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define SHARD_FILE "shard.csv" // shard index and count, below the output directory
+#define SHARD_ANCHORS 256 // entries of an indirect table that every shard measures to align class labels
+
+/*
+ * A shard measures a contiguous range of the entry indices of every table.
+ * Identical machines or processes each dump one shard, unscatter-merge
+ * assembles the complete tables.
+ */
+typedef struct shard_spec {
+  uint64_t shard; // index of this shard
+  uint64_t shards; // number of shards
+  uint64_t classes = 0; // output classes the shard measured with, 0 if not known
+} shard_spec;
+
+shard_spec parse_shard(std::string spec);
+std::pair<uint64_t, uint64_t> shard_range(uint64_t entries, shard_spec spec);
+std::vector<uint64_t> shard_anchors(uint64_t entries);
+void write_shard_file(std::string output_dir, shard_spec spec);
+shard_spec read_shard_file(std::string output_dir);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _THRESHOLD_H_
+#define _THRESHOLD_H_
+
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t pointer;
+
+#define THRESHOLD_BUCKETS 512 // buckets of the streaming histogram, covering four times the initial threshold
+#define THRESHOLD_CUSUM_SLACK 0.02 // relative deviation of a window estimate that counts as noise
+#define THRESHOLD_CUSUM_LIMIT 0.1 // accumulated relative deviation that triggers a recalibration
+#define THRESHOLD_MIN_SEPARATION 0.5 // share of the variance explained by the split to trust an estimate
+#define THRESHOLD_MIN_CLASS 0.01 // share of the samples both classes need to trust an estimate
+
+/*
+ * Threshold between fast and slow timings that follows drift of the timings
+ * during long runs. Samples are collected in a fixed size histogram, every
+ * window of samples gives an Otsu estimate and a two sided CUSUM test on the
+ * estimates detects when the threshold moved. The window that raised the
+ * alarm may straddle the change, so the next one sets the new threshold.
+ * Only well separated windows take part, a noisy window cannot move it.
+ */
+class StreamingThreshold {
+ private:
+  uint64_t bucket_width;
+  uint64_t window_size; // samples per window
+  uint64_t window_samples;
+  uint64_t windows;
+  std::vector<uint64_t> window; // histogram of the current window
+  double cusum_up;
+  double cusum_down;
+  bool drifted; // the next separated window recalibrates the threshold
+  uint64_t threshold;
+  void end_window();
+
+ public:
+  StreamingThreshold(const std::vector<uint64_t>& calibration, uint64_t window_size);
+  bool estimate(const std::vector<uint64_t>& hist, uint64_t& threshold) const;
+
+  /*
+   * Adds a timing sample, called for every sample the oracle takes
+   */
+  inline void add(uint64_t sample) {
+    size_t bucket = sample / this->bucket_width;
+    if (bucket < THRESHOLD_BUCKETS) {
+      this->window[bucket]++;
+    }
+    if (++this->window_samples == this->window_size) {
+      end_window();
+    }
+  }
+
+  inline uint64_t get() const { return this->threshold; }
+};
+
+#endif
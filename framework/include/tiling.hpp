@@ -0,0 +1,34 @@
+#ifndef _TILING_H_
+#define _TILING_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+typedef uint64_t pointer;
+
+#define TILING_MANIFEST "tiles.csv" // manifest of all tiles, below the output directory
+#define TILING_DIR "tiles" // directory of the tile tables, below the output directory
+
+/*
+ * Relevant bits outside the bit limits are fixed to each assignment in turn,
+ * every assignment is dumped as an independent subcube table (a tile)
+ */
+pointer tile_assignment(const std::vector<uint64_t>& fixed_bits, uint64_t tile);
+
+/*
+ * Lists every tile with the bits it fixes, so tools can stitch the tiles
+ * together or analyse them one by one
+ */
+class TileManifest {
+ private:
+  std::string output_dir;
+  std::ofstream file;
+
+ public:
+  TileManifest(std::string output_dir);
+  std::string add(int64_t bit, uint64_t tile, const std::vector<uint64_t>& fixed_bits);
+};
+
+#endif
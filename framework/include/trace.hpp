@@ -0,0 +1,53 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/icl/interval_set.hpp>
+
+typedef uint64_t pointer;
+
+#define TRACE_MAGIC 0x4543415254534e55ULL // "UNSTRACE"
+#define TRACE_VERSION 1
+
+/*
+ * Address pool a trace was recorded on
+ */
+enum trace_addr_kind {
+  TRACE_ADDR_RANGE, // physical or simulated memory with holes
+  TRACE_ADDR_VIRT // contiguous virtual memory
+};
+
+/*
+ * Trace file header, followed by range_count (lower, upper, bounds) triples of
+ * mappable memory and the records until the end of the file, the bounds are
+ * kept so that address selection behaves exactly as in the recorded run
+ */
+typedef struct trace_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t addr_kind;
+  uint64_t seed; // seed of the address pool when the framework started
+  uint64_t maxbits;
+  uint64_t output_classes; // output classes of the oracle when recording started
+  uint32_t naive; // recorded with the naive framework
+  uint32_t range_count;
+} trace_header;
+
+/*
+ * One raw oracle response, addresses are stored unmapped so they stay valid
+ * across runs
+ */
+typedef struct trace_record {
+  uint64_t addr;
+  uint32_t result;
+  uint32_t cycles; // duration of the oracle call in tsc cycles
+} trace_record;
+
+void write_trace_header(std::ostream& out, trace_header header, const boost::icl::interval_set<pointer>& ranges);
+size_t format_trace_record(char* out, const trace_record& record);
+trace_header read_trace(std::string path, boost::icl::interval_set<pointer>& ranges, std::vector<trace_record>& records);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _TRUTH_TABLE_H_
+#define _TRUTH_TABLE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef uint64_t pointer;
+
+#define ENTRY_MISSING 0 // entry is not part of any dump read so far
+#define ENTRY_UNMAPPED 1 // address could not be mapped, written as - in the dumps
+#define ENTRY_KNOWN 2 // entry has a measured class
+#define MARGIN_FULL 100 // margin of a unanimous decision, margins are percent of the votes
+#define DUMP_HEADER "addr,class,margin\n" // first line of every dump
+
+/*
+ * Truth table as dumped by the frameworks, entry x holds the address whose
+ * relevant bit bits[i] equals bit i of x
+ */
+typedef struct truth_table {
+  std::vector<uint64_t> bits; // relevant bits within the limits
+  std::vector<pointer> addrs; // address the entry was measured on
+  std::vector<uint64_t> values; // measured class
+  std::vector<uint32_t> margins; // votes of the class minus those of the runner up
+  std::vector<uint8_t> state; // ENTRY_MISSING, ENTRY_UNMAPPED or ENTRY_KNOWN
+} truth_table;
+
+/*
+ * One line of a dump, index is the entry of the table it belongs to
+ */
+typedef struct dump_entry {
+  uint64_t index;
+  pointer addr;
+  uint64_t value;
+  bool mapped;
+  uint32_t margin; // MARGIN_FULL for dumps without margins
+} dump_entry;
+
+/*
+ * A table file of a dump directory
+ */
+typedef struct dump_table {
+  std::string file; // path below the dump directory
+  std::vector<uint64_t> bits; // relevant bits within the limits
+  bool naive; // classes are labels of an indirect oracle
+} dump_table;
+
+std::vector<std::vector<uint64_t>> read_bits_file(std::string path);
+void write_bits_file(std::string path, const std::vector<std::vector<uint64_t>>& bits);
+truth_table make_truth_table(const std::vector<uint64_t>& bits);
+void for_each_dump_entry(std::string path, const std::vector<uint64_t>& bits,
+                         const std::function<void(const dump_entry&)>& handle);
+std::vector<dump_entry> read_dump(std::string path, const std::vector<uint64_t>& bits);
+truth_table read_truth_table(std::string path, const std::vector<uint64_t>& bits);
+void write_dump(std::string path, const truth_table& table);
+std::vector<dump_table> list_dump_tables(std::string dir, const std::vector<std::vector<uint64_t>>& bits);
+
+#endif
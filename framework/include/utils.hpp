@@ -56,7 +56,7 @@ std::ostream& operator<<(std::ostream& out, const std::pair<T,U>& p) {
 /*
 * Gets the index in the total mesurement series based on the bitmask vector and address
 */
-static uint64_t idx_from_idx_vec_and_addr(std::vector<uint64_t> idx_vec, pointer addr){
+static uint64_t idx_from_idx_vec_and_addr(const std::vector<uint64_t>& idx_vec, pointer addr){
   uint64_t idx = 0;
   for (size_t i = 0; i < idx_vec.size(); i++)
   {
@@ -65,6 +65,18 @@ static uint64_t idx_from_idx_vec_and_addr(std::vector<uint64_t> idx_vec, pointer
   return idx;
 }
 
+/*
+* Inverse of idx_from_idx_vec_and_addr, places the bits of idx at the indices of idx_vec
+*/
+static pointer addr_from_idx_vec_and_idx(const std::vector<uint64_t>& idx_vec, uint64_t idx){
+  pointer addr = 0;
+  for (size_t i = 0; i < idx_vec.size(); i++)
+  {
+    addr |= ((idx >> i) & 0x1) << idx_vec[i];
+  }
+  return addr;
+}
+
 /*
 * Function that performs a memory access on the specified virtual address
 */
@@ -152,31 +164,33 @@ static uint64_t findMedianSorted(std::vector<uint64_t>& v,size_t offset) {
 // ----------------------------------------------
 static uint64_t ostsu_treshold(std::vector<uint64_t> measures){
   
-  // Prefilter to remove outlier
-  std::sort(measures.begin(), measures.end());
-  auto Q1 = findMedianSorted(measures,0);
-  auto Q3 = findMedianSorted(measures,measures.size()/2);
-  auto IQR = Q3 - Q1;
-
-  std::vector<uint64_t>::iterator it = measures.begin();
-  while (it != measures.end()) {
-      if (*it < Q1 - 1.5 * IQR || *it > Q3 + 1.5 * IQR) {
-          it = measures.erase(it);
-      } else {
-          ++it;
-      }
+  if(measures.empty()){
+    return 0;
   }
+  // Prefilter to remove outlier, the quartiles are the medians of the lower and upper half
+  std::sort(measures.begin(), measures.end());
+  std::vector<uint64_t> lower(measures.begin(), measures.begin() + (measures.size() + 1) / 2);
+  double Q1 = findMedianSorted(lower,0);
+  double Q3 = findMedianSorted(measures,measures.size()/2);
+  double IQR = Q3 - Q1;
+
+  measures.erase(std::remove_if(measures.begin(), measures.end(),
+                                [&](uint64_t m) { return m < Q1 - 1.5 * IQR || m > Q3 + 1.5 * IQR; }),
+                 measures.end());
 
   // Normalize remaining vector entries
   auto min = *measures.begin();
-  auto max = *measures.end();
+  auto max = measures.back();
+  if(max == min){
+    return min;
+  }
   for (size_t i = 0; i < measures.size(); i++)
   {
     measures[i] = ((measures[i]-min)*255)/((float)(max-min));
   }
 
   // Build a histogram for the vector
-  std::vector<uint64_t> hist(255,0);
+  std::vector<uint64_t> hist(256,0);
   for (size_t i = 0; i < measures.size(); i++)
   {
     hist[measures[i]]++;  
@@ -0,0 +1,46 @@
+#ifndef _VERIFY_H_
+#define _VERIFY_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+
+#include "addr.hpp"
+#include "hash-function.hpp"
+
+#define VERIFY_SAMPLES 10000 // random addresses measured by default
+#define VERIFY_CONFIRMATIONS 3 // robust remeasures that have to repeat a mismatch before it counts
+#define VERIFY_Z 1.96 // quantile of the reported 95% bounds
+#define VERIFY_FILE "verify.csv" // sampled mismatches, below the output directory
+
+/*
+ * Checks a candidate hash function against the oracle on random addresses.
+ * A mismatch that robust remeasures repeat refutes the function and ends the
+ * check, others are counted as noise. The agreement is reported with Wilson
+ * score bounds. A function of a single output bit is compared with that bit
+ * of the hash.
+ */
+class Verification {
+ private:
+  const HashFunction& function;
+  bool direct; // the oracle returns the hash, otherwise its class labels are matched to hash values
+  std::map<uint64_t, uint64_t> label_values; // hash value of every class label seen so far
+  std::map<uint64_t, uint64_t> value_labels;
+  std::ofstream file;
+  uint64_t samples = 0;
+  uint64_t agreeing = 0;
+  uint64_t noise = 0; // mismatches the remeasures did not repeat
+  uint64_t observe(uint64_t measured);
+  bool agrees(uint64_t measured, uint64_t predicted);
+  size_t repeats(pointer mapped_addr, pointer select_addr, uint64_t measured,
+                 const std::function<uint64_t(pointer, pointer)>& measure);
+  void report(bool refuted);
+
+ public:
+  Verification(const HashFunction& function, bool direct, std::string output_dir);
+  bool run(IAddr* addr, size_t samples, std::function<uint64_t(pointer, pointer)> measure);
+};
+
+#endif
@@ -22,9 +22,10 @@ std::pair<pointer, pointer> IAddr::get_flip_pair(int idx) {
 }
 
 /*
-* Intializes the bitmask iterator
+* Intializes the bitmask iterator at start. It counts through the bits of
+* idx_vec within walk, the other bits of idx_vec keep their value from start.
 */
-void IAddr::init_bitmask_iterator(std::vector<uint64_t> idx_vec) {
+void IAddr::init_bitmask_iterator(std::vector<uint64_t> idx_vec, pointer start, uint64_t walk) {
   // Init bitmask
   uint64_t bitmask = 0;
   for(uint64_t idx : idx_vec){
@@ -41,8 +42,22 @@ void IAddr::init_bitmask_iterator(std::vector<uint64_t> idx_vec) {
 
   this->idx_vec = idx_vec;
   this->idx_vec_invert = idx_vec_invert;
-  this->bitmsask_iterator_position = 0;
+  this->bitmask_invert = 0;
+  for(uint64_t idx : idx_vec_invert){
+    this->bitmask_invert |= 1L << idx;
+  }
+  this->bitmsask_iterator_position = start & bitmask;
   this->bitmask = bitmask;
+  this->walk_mask = bitmask & walk;
+}
+
+/*
+* Position of the iterator after adding step, one combination further is the
+* value of the lowest walked bit. Bits of bitmask outside walk_mask are kept.
+*/
+pointer IAddr::next_iterator_position(size_t step) {
+  auto fixed = this->bitmsask_iterator_position & this->bitmask & ~this->walk_mask;
+  return (((this->bitmsask_iterator_position | ~this->walk_mask) + step) & this->walk_mask) | fixed;
 }
 
 pointer IAddr::get_alternative_addr(pointer addr){
@@ -50,4 +65,15 @@ pointer IAddr::get_alternative_addr(pointer addr){
     addr = flip_unused_bits(addr);
   }while (!(valid_address(addr))); 
   return addr;
-}
\ No newline at end of file
+}
+/*
+* Reseeds the random number generator to get repeatable address sequences
+*/
+void IAddr::seed(uint64_t seed){
+  this->rng_seed = seed;
+  this->rnd.seed(seed);
+}
+
+uint64_t IAddr::get_seed(){
+  return this->rng_seed;
+}
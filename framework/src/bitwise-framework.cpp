@@ -1,5 +1,6 @@
 
 #include <cstdint>
+#include <cstdlib>
 #include <exception>
 #include <fstream>
 #include <functional>
@@ -28,12 +29,25 @@
 #include "../include/utils.hpp"
 #include "../include/framework.hpp"
 #include "../include/oracle.hpp"
+#include "../include/metrics.hpp"
+#include "../include/progress.hpp"
+#include "../include/housekeeping.hpp"
+#include "../include/verify.hpp"
+#include "../include/consistency.hpp"
 
 #define THRESHOLD_FIXPOINT_ITERATION 1000
 #define ITERATIONS_INPUT_SPACE_MEASURE 100
 #define WEAK_ORACLE_FIXPOINT_ITERATON 100
 #define MAX_RETRIES_ORACLE 100
 #define MULTIMEASURE
+#define CONSISTENCY_ROUNDS 3 // rounds of consistency checks and remeasures in the two pass dump
+
+/*
+ * Number of relevant bits that lie within the bit limits
+ */
+static size_t bits_within_limits(const std::vector<uint64_t>& bits, uint64_t hi, uint64_t lo){
+  return std::count_if(bits.begin(), bits.end(), [hi, lo](uint64_t b){ return b < hi && b > lo; });
+}
 
 /*
  * Peroforms fixpoint iteration with threshold to find the number of output
@@ -41,14 +55,19 @@
  * If concrete output classes are known beforehand this part can be skipped.
  * To skip this step just overwrite the output classes of the framework direcly.
  */
-void BitwiseFramework::determine_output_classes() {
+template <typename AddrT, typename OracleT>
+void BitwiseFramework<AddrT, OracleT>::determine_output_classes() {
   std::set<uint64_t> oracle_outputs;
   uint64_t unchanged_iterations = 0;
   while (unchanged_iterations < THRESHOLD_FIXPOINT_ITERATION) {
     auto size_before = oracle_outputs.size();
-    auto random_addr = this->addr->get_random_addr();
-    auto mapped_addr = this->addr->map_addr(random_addr);
-    oracle_outputs.insert(this->oracle->oracle(mapped_addr));
+    pointer mapped_addr;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      auto random_addr = this->addr->get_random_addr();
+      mapped_addr = this->addr->map_addr(random_addr);
+    }
+    oracle_outputs.insert(this->oracle->template timed_oracle<OracleT>(mapped_addr));
     auto size_after = oracle_outputs.size();
     if (size_before == size_after) {
       unchanged_iterations++;
@@ -65,11 +84,13 @@ void BitwiseFramework::determine_output_classes() {
  * The precision of this measurement can be increased by increasing the
  * threshold parameter
  */
-void BitwiseFramework::get_input_space_bits() {
+template <typename AddrT, typename OracleT>
+void BitwiseFramework<AddrT, OracleT>::get_input_space_bits() {
   // Iterate over all determined output classes and compute relevant input bits
   for (size_t out_class_idx = 0; out_class_idx < ceil(log2(this->output_classes));
        out_class_idx++) {
     std::vector<uint64_t> out_class_bits;
+    Metrics::set_bit(out_class_idx);
     PLOG_INFO << "Computing relevant input space for bit " << out_class_idx;
     PLOG_DEBUG << this->addr->maxbits;
     // Try each address bit that can be mapped
@@ -83,14 +104,20 @@ void BitwiseFramework::get_input_space_bits() {
       for (size_t iteration = 0; iteration < ITERATIONS_INPUT_SPACE_MEASURE;
            iteration++) {
         // Get a pair of addresses where the bit index addr_bit is flipped between the two addresses
-        auto pair = this->addr->get_flip_pair(addr_bit);
-        auto addr_1 = pair.first;
-        auto addr_2 = pair.second;
-        auto addr_1_mapped = this->addr->map_addr(addr_1);
-        auto addr_2_mapped = this->addr->map_addr(addr_2);
+        pointer addr_1, addr_2, addr_1_mapped, addr_2_mapped;
+        {
+          MetricsTimer timer(COUNTER_ADDR_NS);
+          auto pair = this->addr->get_flip_pair(addr_bit);
+          addr_1 = pair.first;
+          addr_2 = pair.second;
+          addr_1_mapped = this->addr->map_addr(addr_1);
+          addr_2_mapped = this->addr->map_addr(addr_2);
+        }
+        // Measuring one must not unmap the other
+        AddrPin pin_1(this->addr, addr_1), pin_2(this->addr, addr_2);
 
-        auto first_measure = this->oracle->oracle_robust(addr_1_mapped, addr_1, MAX_RETRIES_ORACLE);
-        auto second_measure = this->oracle->oracle_robust(addr_2_mapped, addr_2, MAX_RETRIES_ORACLE);
+        auto first_measure = this->oracle->template oracle_robust<OracleT>(addr_1_mapped, addr_1, MAX_RETRIES_ORACLE);
+        auto second_measure = this->oracle->template oracle_robust<OracleT>(addr_2_mapped, addr_2, MAX_RETRIES_ORACLE);
         addr_bit_relevant |= ((first_measure >> out_class_idx) & 0x1) != ((second_measure >> out_class_idx) & 0x1);
         if(((first_measure >> out_class_idx) & 0x1) != ((second_measure >> out_class_idx) & 0x1)){
           true_cnt++;
@@ -111,8 +138,9 @@ void BitwiseFramework::get_input_space_bits() {
     }
 
     // Dump relevant input space bits
+    MetricsTimer timer(COUNTER_IO_NS);
     std::ofstream bitfile;
-    bitfile.open("measurements/bits.csv");
+    bitfile.open(this->output_dir + "/bits.csv");
 
     for(auto input_space : this->input_space_bits){
       if(input_space_bits.size() != 0){
@@ -131,26 +159,166 @@ void BitwiseFramework::get_input_space_bits() {
   }
 }
 
+/*
+* Measures an address robustly, retrying until the oracle reaches a decision
+*/
+template <typename AddrT, typename OracleT>
+uint64_t BitwiseFramework<AddrT, OracleT>::measure_robust(pointer mapped_addr, pointer select_addr){
+  if(this->numa){
+    this->numa->schedule(select_addr);
+  }
+  while (true)
+  {
+    try{
+      // This can error if the maximum retry  is exceeded
+      return this->oracle->template oracle_robust<OracleT>(mapped_addr,select_addr,10);
+    }catch (const OracleMiss&){
+      throw;
+    }catch (...){
+      PLOG_DEBUG << "REMEASURE triggerd while dumping";
+    }
+  }
+}
+
+/*
+* Dumps one truth table in two passes. Every entry is measured with a few raw
+* oracle calls first, then only entries that contradict the structure of the
+* table or whose calls disagree are measured robustly.
+*/
+template <typename AddrT, typename OracleT>
+void BitwiseFramework<AddrT, OracleT>::dump_bit_two_pass(size_t bit_idx, const std::vector<uint64_t>& bit_idx_reduce, size_t iterations,
+                                                         pointer fixed, std::vector<bool>& seen_idx, DumpWriter& dumpfile){
+  size_t vars = bit_idx_reduce.size();
+  auto table = make_bit_table(vars);
+  auto known = make_bit_table(vars);
+  std::vector<bool> robust(iterations); // indexed by table entry
+  std::vector<uint32_t> margins(iterations); // indexed by table entry
+  std::vector<uint64_t> suspicious;
+
+  // Cheap pass
+  for (size_t i = 0; i < iterations; i++)
+  {
+    std::pair<pointer,bool> addr_tuple;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+    }
+    pointer select_addr = addr_tuple.first;
+    auto x = idx_from_idx_vec_and_addr(bit_idx_reduce, select_addr);
+    seen_idx[x] = true;
+    Metrics::add(COUNTER_ENTRIES);
+    if(!addr_tuple.second){
+      Metrics::add(COUNTER_UNMAPPABLE);
+      Progress::advance();
+      continue;
+    }
+    auto mapped_addr = this->addr->map_addr(select_addr);
+    if(this->numa){
+      this->numa->schedule(select_addr);
+    }
+    int ones = 0;
+    bool noise = false;
+    try{
+      this->oracle->template timed_round<OracleT>(mapped_addr, this->first_pass_calls,
+                                                  [&](uint64_t out) { ones += (out >> bit_idx) & 0x1; });
+    }catch (const OracleNoise&){
+      // Left to the robust measurement
+      ones = 0;
+      noise = true;
+    }
+    set_entry(table, x, 2 * ones > this->first_pass_calls);
+    set_entry(known, x, true);
+    margins[x] = noise ? 0 : (MARGIN_FULL * std::abs(2 * ones - this->first_pass_calls)) / this->first_pass_calls;
+    if(noise || (ones != 0 && ones != this->first_pass_calls)){
+      suspicious.push_back(x);
+    }
+    Progress::advance();
+  }
+
+  // Robust measurements of the suspicious entries until the table is consistent
+  auto structure = find_structure(table, known, vars);
+  PLOG_INFO << "h[" << bit_idx << "] has " << structure.linear.size() << " linear variables and "
+            << structure.separable.size() << " separable variable pairs to check the table with";
+  if(structure.linear.empty() && structure.separable.empty()){
+    PLOG_WARNING << "h[" << bit_idx << "] has no structure to check, only entries with disagreeing calls are remeasured";
+  }
+  uint64_t remeasured = 0;
+  for (size_t round = 0; round < CONSISTENCY_ROUNDS; round++)
+  {
+    for (auto x : find_inconsistent(table, known, vars, structure))
+    {
+      suspicious.push_back(x);
+    }
+    uint64_t measured = 0;
+    for (auto x : suspicious)
+    {
+      if(robust[x] || !get_entry(known, x)){
+        continue;
+      }
+      // The address is recomputed from the entry, only bits outside the relevant ones may differ
+      pointer select_addr = fixed | addr_from_idx_vec_and_idx(bit_idx_reduce, x);
+      if(!this->addr->valid_address(select_addr)){
+        select_addr = this->addr->get_alternative_addr(select_addr);
+      }
+      auto oracle_out = measure_robust(this->addr->map_addr(select_addr), select_addr);
+      set_entry(table, x, (oracle_out >> bit_idx) & 0x1);
+      margins[x] = this->oracle->bit_margin(bit_idx);
+      robust[x] = true;
+      measured++;
+    }
+    suspicious.clear();
+    Metrics::add(COUNTER_FLAGGED, measured);
+    remeasured += measured;
+    if(!measured){
+      break;
+    }
+  }
+  PLOG_INFO << "h[" << bit_idx << "] " << remeasured << "/" << iterations << " entries remeasured robustly";
+
+  // Walk the entries again for their addresses instead of keeping one per entry
+  this->addr->init_bitmask_iterator(this->input_space_bits[bit_idx], fixed);
+  for (size_t i = 0; i < iterations; i++)
+  {
+    pointer select_addr;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      select_addr = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0])).first;
+    }
+    auto x = idx_from_idx_vec_and_addr(bit_idx_reduce, select_addr);
+    MetricsTimer timer(COUNTER_IO_NS);
+    dumpfile.push(dump_record{select_addr, get_entry(table, x), get_entry(known, x), margins[x]});
+  }
+}
+
 /*
 * Dumps truth tables for all relevant bits
 */
-void BitwiseFramework::dump_truth_table(){
+template <typename AddrT, typename OracleT>
+void BitwiseFramework<AddrT, OracleT>::dump_truth_table(){
+  // Announce the entries of all tables to the progress reporter
+  uint64_t run_entries = 0;
   for (size_t bit_idx = 0; bit_idx < this->input_space_bits.size(); bit_idx++)
   {
     if(this->input_space_linear[bit_idx]){
-      PLOG_INFO << "h[" << bit_idx << "] is linear, skipping dump";
       continue;
     }
-    
-    // Open dumpfile
-    std::ofstream dumpfile;
-    char buff[100];
-    snprintf(buff, sizeof(buff), "measurements/bit_%ld.csv", bit_idx);
-    dumpfile.open(buff);
-    dumpfile << "addr,class\n";
+    auto bits = this->input_space_bits[bit_idx].size();
+    auto within = bits_within_limits(this->input_space_bits[bit_idx], this->bit_limit_hi, this->bit_limit_lo);
+    auto range = shard_range(1ULL << within, this->shard);
+    run_entries += (this->tile ? 1ULL << (bits - within) : 1) * (range.second - range.first);
+  }
+  Progress::begin_run(run_entries);
+  if(this->tile){
+    this->manifest.reset(new TileManifest(this->output_dir));
+  }
 
-    // Init bitmask iterator
-    this->addr->init_bitmask_iterator(this->input_space_bits[bit_idx]);
+  for (size_t bit_idx = 0; bit_idx < this->input_space_bits.size(); bit_idx++)
+  {
+    if(this->input_space_linear[bit_idx]){
+      PLOG_INFO << "h[" << bit_idx << "] is linear, skipping dump";
+      continue;
+    }
+    Metrics::set_bit(bit_idx);
 
     // Reduce by applying lower and upper bit bounds
     auto reduce = 0;
@@ -165,60 +333,69 @@ void BitwiseFramework::dump_truth_table(){
       }
     }
     size_t iterations = 1L << (this->input_space_bits[bit_idx].size()-reduce);
+    auto range = shard_range(iterations, this->shard);
 
-    
-    PLOG_INFO << "Dumping h[" << bit_idx << "] iteration count " << iterations;
-    std::vector<bool> seen_idx(iterations);
-    // Iterate over addresses dumping truth table
-    int perc = 0, last_perc = -1;
-    for (size_t i = 0; i < iterations ; i++)
+    // Tiling fixes the bits outside the limits to each assignment in turn,
+    // without it they stay zero
+    size_t tiles = this->tile ? 1ULL << bit_idx_expand.size() : 1;
+    for (size_t tile = 0; tile < tiles; tile++)
     {
-      // Try to determine output class of an address
-      auto addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
-      pointer select_addr = addr_tuple.first;
-      bool can_map = addr_tuple.second;
-      if(!can_map){
-        dumpfile << select_addr << ", "<< "-" << "\n";
-      }else{
-        int count = 0;
-        // Try to map an address
-        auto mapped_addr = this->addr->map_addr(select_addr);
-        // Try to measure until succesfull
-        bool oracle_success = false;
-        uint64_t oracle_out = 0;
-        while (!oracle_success)
+      // Open dumpfile, it is written by a housekeeping thread
+      char buff[100];
+      snprintf(buff, sizeof(buff), "/bit_%ld.csv", bit_idx);
+      auto path = this->tile ? this->manifest->add(bit_idx, tile, bit_idx_expand) : this->output_dir + buff;
+      DumpWriter dumpfile(path, this->pla, bit_idx_reduce, bit_idx);
+
+      // Init bitmask iterator at the first entry of the shard
+      this->addr->init_bitmask_iterator(this->input_space_bits[bit_idx], tile_assignment(bit_idx_expand, tile) |
+                                        addr_from_idx_vec_and_idx(bit_idx_reduce, range.first));
+
+      PLOG_INFO << "Dumping h[" << bit_idx << "]" << (this->tile ? " tile " + std::to_string(tile) : "") << " iteration count " << iterations
+                << (this->shard.shards > 1 ? ", entries " + std::to_string(range.first) + " to " + std::to_string(range.second) : "");
+      Progress::begin_table(bit_idx, range.second - range.first);
+      std::vector<bool> seen_idx(iterations);
+      if(this->two_pass){
+        dump_bit_two_pass(bit_idx, bit_idx_reduce, iterations, tile_assignment(bit_idx_expand, tile), seen_idx, dumpfile);
+      }
+      // Iterate over addresses dumping truth table
+      for (size_t i = range.first; i < range.second && !this->two_pass; i++)
+      {
+        // Try to determine output class of an address
+        std::pair<pointer,bool> addr_tuple;
         {
-          try{
-          // This can error if the maximum retry  is exceeded
-          oracle_out = this->oracle->oracle_robust(mapped_addr,select_addr,10); 
-          //std::cout << ((oracle_out>>bit_idx) & 0x1) << "\n"; 
-          dumpfile << select_addr << ", "<< ((oracle_out>>bit_idx) & 0x1) << "\n";
-          count += ((oracle_out>>bit_idx) & 0x1);
-          oracle_success = true;
-          }catch (...){
-            PLOG_DEBUG << "REMEASURE triggerd while dumping";
-          }
+          MetricsTimer timer(COUNTER_ADDR_NS);
+          addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+        }
+        pointer select_addr = addr_tuple.first;
+        bool can_map = addr_tuple.second;
+        Metrics::add(COUNTER_ENTRIES);
+        if(!can_map){
+          Metrics::add(COUNTER_UNMAPPABLE);
+          MetricsTimer timer(COUNTER_IO_NS);
+          dumpfile.push(dump_record{select_addr, 0, false, 0});
+        }else{
+          // Try to map an address
+          auto mapped_addr = this->addr->map_addr(select_addr);
+          auto oracle_out = measure_robust(mapped_addr, select_addr);
+          MetricsTimer timer(COUNTER_IO_NS);
+          dumpfile.push(dump_record{select_addr, (oracle_out>>bit_idx) & 0x1, true, this->oracle->bit_margin(bit_idx)});
         }
-      }
         
-      seen_idx[idx_from_idx_vec_and_addr(bit_idx_reduce,select_addr)] = true;
-      perc = (int)(i * 100.0 / iterations);
-      if(perc != last_perc) {
-        PLOG_DEBUG << perc <<"% " << i << "/" << iterations;
-        last_perc = perc;
+        seen_idx[idx_from_idx_vec_and_addr(bit_idx_reduce,select_addr)] = true;
+        Progress::advance();
       }
-    }
-    // If one index has not been mapped throw an error
-    bool abort = false;
-    for (size_t i = 0; i < iterations; i++)
-    {
-      if(!seen_idx[i]){
-        PLOG_ERROR << "Bit:" << bit_idx << " Unmapped Idx:" << i; 
-        abort = true;
+      // If one index has not been mapped throw an error
+      bool abort = false;
+      for (size_t i = range.first; i < range.second; i++)
+      {
+        if(!seen_idx[i]){
+          PLOG_ERROR << "Bit:" << bit_idx << " Unmapped Idx:" << i; 
+          abort = true;
+        }
+      }
+      if(abort){
+        PLOG_ERROR << "Unexplored index detected, for bit " << bit_idx << ". This is most likely a bug!";
       }
-    }
-    if(abort){
-      PLOG_ERROR << "Unexplored index detected, for bit " << bit_idx << ". This is most likely a bug!";
     }
   }
 }
@@ -226,10 +403,19 @@ void BitwiseFramework::dump_truth_table(){
 /*
  * Performs a dry run without measurements, good for debugging
  */
-void BitwiseFramework::dry_run(){
+template <typename AddrT, typename OracleT>
+void BitwiseFramework<AddrT, OracleT>::dry_run(){
+  uint64_t run_entries = 0;
+  for (auto& bits : this->input_space_bits)
+  {
+    run_entries += 1ULL << bits_within_limits(bits, this->bit_limit_hi, this->bit_limit_lo);
+  }
+  Progress::begin_run(run_entries);
+
   for (size_t bit_idx = 0; bit_idx < this->input_space_bits.size(); bit_idx++)
   {
     uint64_t unmappable = 0;
+    Metrics::set_bit(bit_idx);
     // Init bitmask iterator
     this->addr->init_bitmask_iterator(this->input_space_bits[bit_idx]);
 
@@ -249,25 +435,27 @@ void BitwiseFramework::dry_run(){
 
     
     PLOG_INFO << "Dry run on h[" << bit_idx << "] iteration count " << iterations;
+    Progress::begin_table(bit_idx, iterations);
     std::vector<bool> seen_idx(iterations);
     // Iterate over addresses dumping truth table
-    int perc = 0, last_perc = -1;
     for (size_t i = 0; i < iterations ; i++)
     {
       // Try to determine output class of an address
-      auto addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+      std::pair<pointer,bool> addr_tuple;
+      {
+        MetricsTimer timer(COUNTER_ADDR_NS);
+        addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+      }
       pointer select_addr = addr_tuple.first;
       bool can_map = addr_tuple.second;
+      Metrics::add(COUNTER_ENTRIES);
       if(!can_map){
+        Metrics::add(COUNTER_UNMAPPABLE);
         unmappable++;
       }
         
       seen_idx[idx_from_idx_vec_and_addr(bit_idx_reduce,select_addr)] = true;
-      perc = (int)(i * 100.0 / iterations);
-      if(perc != last_perc) {
-        PLOG_DEBUG << perc <<"% " << i << "/" << iterations;
-        last_perc = perc;
-      }
+      Progress::advance();
     }
     // If one index has not been mapped throw an error
     bool abort = false;
@@ -286,10 +474,23 @@ void BitwiseFramework::dry_run(){
   
 }
 
+/*
+ * Checks a candidate function on random addresses. The oracle returns the
+ * hash, or class codes after relabelling that are matched to hash values.
+ */
+template <typename AddrT, typename OracleT>
+bool BitwiseFramework<AddrT, OracleT>::verify(const HashFunction& function, size_t samples){
+  Verification verification(function, !this->labelled, this->output_dir);
+  return verification.run(this->addr, samples, [this](pointer mapped_addr, pointer select_addr){
+    return measure_robust(mapped_addr, select_addr);
+  });
+}
+
 /*
  * Initializer for the framework that allows to pin the code to a core.
  */
-BitwiseFramework::BitwiseFramework(int core, IAddr* addr, Oracle* oracle) {
+template <typename AddrT, typename OracleT>
+BitwiseFramework<AddrT, OracleT>::BitwiseFramework(int core, AddrT* addr, OracleT* oracle) {
   // Set selected oracle and address type
   this->addr = addr;
   this->oracle = oracle;
@@ -299,8 +500,17 @@ BitwiseFramework::BitwiseFramework(int core, IAddr* addr, Oracle* oracle) {
   sched_setaffinity(getpid(), sizeof(cpu_set_t), &mask);
 }
 
-BitwiseFramework::~BitwiseFramework() {
-  delete this->addr;
+template <typename AddrT, typename OracleT>
+BitwiseFramework<AddrT, OracleT>::~BitwiseFramework() {
+  if(this->owns_addr){
+    delete this->addr;
+  }
   delete this->oracle;
 }
 
+
+// Address pool and oracle combinations the framework is built for
+template class BitwiseFramework<IAddr, Oracle>;
+template class BitwiseFramework<PhysAddr, SliceOracle>;
+template class BitwiseFramework<PhysAddr, SliceTimingOracle>;
+template class BitwiseFramework<SimAddr, SimOracle>;
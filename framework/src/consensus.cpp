@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "../include/consensus.hpp"
+
+/*
+ * Adds weight to the bit sliced counters of all entries in mask, counter
+ * planes are stored per word so that the ripple carry stays in cache
+ */
+static void add_masked(uint64_t* planes, size_t plane_count, uint64_t mask, unsigned weight) {
+  uint64_t carry = 0;
+  for (size_t p = 0; p < plane_count; p++) {
+    uint64_t addend = ((weight >> p) & 0x1) ? mask : 0;
+    uint64_t sum = planes[p] ^ addend ^ carry;
+    carry = (planes[p] & addend) | (carry & (planes[p] ^ addend));
+    planes[p] = sum;
+  }
+}
+
+static uint64_t counter_value(const uint64_t* planes, size_t plane_count, size_t bit) {
+  uint64_t value = 0;
+  for (size_t p = 0; p < plane_count; p++) {
+    value |= ((planes[p] >> bit) & 0x1) << p;
+  }
+  return value;
+}
+
+/*
+ * Consensus is a decision of the winner, the margin only decides whether it is disputed
+ */
+static bool is_disputed(uint64_t agree, uint64_t total, double dispute) {
+  return 2 * agree <= total || (double)(total - agree) >= dispute * total;
+}
+
+/*
+ * Fills state and address of the consensus table, the address is taken from
+ * the first run that measured the entry
+ */
+static void merge_states(const std::vector<truth_table>& runs, truth_table& out) {
+  out = make_truth_table(runs[0].bits);
+  for (auto& run : runs) {
+    if (run.bits != out.bits) {
+      std::throw_with_nested(std::runtime_error("Runs have different relevant bits"));
+    }
+    for (size_t x = 0; x < run.state.size(); x++) {
+      if (run.state[x] > out.state[x]) {
+        out.state[x] = run.state[x];
+        out.addrs[x] = run.addrs[x];
+      }
+    }
+  }
+}
+
+/*
+ * Weighted majority vote over tables with one output bit. Votes are counted
+ * 64 entries at a time in bit sliced counters. Unanimous entries are found
+ * with word operations, only contested entries decode their counters.
+ */
+consensus_stats consensus_bitwise(const std::vector<truth_table>& runs, const std::vector<unsigned>& weights,
+                                  double dispute, truth_table& out, std::vector<disputed_entry>& disputed) {
+  merge_states(runs, out);
+  size_t entries = out.state.size();
+  size_t words = (entries + 63) / 64;
+  uint64_t weight_sum = 0;
+  for (auto weight : weights) {
+    weight_sum += weight;
+  }
+  size_t plane_count = 1;
+  while ((weight_sum >> plane_count) != 0) {
+    plane_count++;
+  }
+
+  // ones counts the weight voting 1, total the weight of all votes
+  std::vector<uint64_t> ones(words * plane_count, 0), total(words * plane_count, 0);
+  std::vector<uint64_t> value_bits(words), known_bits(words);
+  for (size_t r = 0; r < runs.size(); r++) {
+    std::fill(value_bits.begin(), value_bits.end(), 0);
+    std::fill(known_bits.begin(), known_bits.end(), 0);
+    for (size_t x = 0; x < entries; x++) {
+      if (runs[r].state[x] == ENTRY_KNOWN) {
+        known_bits[x / 64] |= 1ULL << (x % 64);
+        value_bits[x / 64] |= (runs[r].values[x] & 0x1) << (x % 64);
+      }
+    }
+    for (size_t w = 0; w < words; w++) {
+      add_masked(&ones[w * plane_count], plane_count, value_bits[w] & known_bits[w], weights[r]);
+      add_masked(&total[w * plane_count], plane_count, known_bits[w], weights[r]);
+    }
+  }
+
+  consensus_stats stats{0, 0, 0, 0};
+  for (size_t w = 0; w < words; w++) {
+    uint64_t valid = (w == words - 1 && entries % 64) ? (1ULL << (entries % 64)) - 1 : ~0ULL;
+    uint64_t voted = 0, any_one = 0, differ = 0;
+    for (size_t p = 0; p < plane_count; p++) {
+      voted |= total[w * plane_count + p];
+      any_one |= ones[w * plane_count + p];
+      differ |= ones[w * plane_count + p] ^ total[w * plane_count + p];
+    }
+    uint64_t all_one = voted & ~differ;
+    uint64_t all_zero = voted & ~any_one;
+    uint64_t contested = voted & ~all_one & ~all_zero;
+    stats.unanimous += __builtin_popcountll(all_one | all_zero);
+    stats.contested += __builtin_popcountll(contested);
+    stats.unvoted += __builtin_popcountll(~voted & valid);
+
+    for (auto bits = all_one | all_zero; bits; bits &= bits - 1) {
+      out.values[w * 64 + __builtin_ctzll(bits)] = (all_one >> __builtin_ctzll(bits)) & 0x1;
+      out.margins[w * 64 + __builtin_ctzll(bits)] = MARGIN_FULL;
+    }
+    for (auto bits = contested; bits; bits &= bits - 1) {
+      size_t bit = __builtin_ctzll(bits);
+      uint64_t x = w * 64 + bit;
+      auto one_weight = counter_value(&ones[w * plane_count], plane_count, bit);
+      auto total_weight = counter_value(&total[w * plane_count], plane_count, bit);
+      out.values[x] = 2 * one_weight > total_weight;
+      auto agree = out.values[x] ? one_weight : total_weight - one_weight;
+      out.margins[x] = (MARGIN_FULL * (2 * agree - total_weight)) / total_weight;
+      if (is_disputed(agree, total_weight, dispute)) {
+        disputed.push_back(disputed_entry{x, out.values[x], agree, total_weight});
+        stats.disputed++;
+      }
+    }
+  }
+  return stats;
+}
+
+/*
+ * Weighted plurality vote over tables with class labels, ties go to the
+ * smallest label
+ */
+consensus_stats consensus_classes(const std::vector<truth_table>& runs, const std::vector<unsigned>& weights,
+                                  double dispute, truth_table& out, std::vector<disputed_entry>& disputed) {
+  merge_states(runs, out);
+  consensus_stats stats{0, 0, 0, 0};
+  std::map<uint64_t, uint64_t> votes;
+  for (size_t x = 0; x < out.state.size(); x++) {
+    votes.clear();
+    uint64_t total = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+      if (runs[r].state[x] == ENTRY_KNOWN) {
+        votes[runs[r].values[x]] += weights[r];
+        total += weights[r];
+      }
+    }
+    if (votes.empty()) {
+      stats.unvoted++;
+      continue;
+    }
+    auto winner = std::max_element(votes.begin(), votes.end(),
+                                   [](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) {
+                                     return a.second < b.second;
+                                   });
+    out.values[x] = winner->first;
+    if (votes.size() == 1) {
+      out.margins[x] = MARGIN_FULL;
+      stats.unanimous++;
+      continue;
+    }
+    uint64_t runner_up = 0;
+    for (auto& vote : votes) {
+      if (vote.first != winner->first) {
+        runner_up = std::max(runner_up, vote.second);
+      }
+    }
+    out.margins[x] = (MARGIN_FULL * (winner->second - runner_up)) / total;
+    stats.contested++;
+    if (is_disputed(winner->second, total, dispute)) {
+      disputed.push_back(disputed_entry{x, winner->first, winner->second, total});
+      stats.disputed++;
+    }
+  }
+  return stats;
+}
+
+/*
+ * Indirect oracles label classes in the order they discovered them, so each
+ * label of a run is mapped to the label of the reference it agrees with most
+ */
+void align_run_labels(const truth_table& reference, truth_table& run) {
+  std::map<uint64_t, std::map<uint64_t, uint64_t>> pairs;
+  for (size_t x = 0; x < run.state.size(); x++) {
+    if (run.state[x] == ENTRY_KNOWN && reference.state[x] == ENTRY_KNOWN) {
+      pairs[run.values[x]][reference.values[x]]++;
+    }
+  }
+  std::map<uint64_t, uint64_t> labels;
+  for (auto& pair : pairs) {
+    labels[pair.first] = std::max_element(pair.second.begin(), pair.second.end(),
+                                          [](const std::pair<uint64_t, uint64_t>& a,
+                                             const std::pair<uint64_t, uint64_t>& b) { return a.second < b.second; })
+                             ->first;
+  }
+  for (size_t x = 0; x < run.state.size(); x++) {
+    if (run.state[x] == ENTRY_KNOWN && labels.count(run.values[x])) {
+      run.values[x] = labels[run.values[x]];
+    }
+  }
+}
@@ -0,0 +1,138 @@
+#include "../include/consistency.hpp"
+
+/*
+ * Masks selecting the entries whose variable var is 0, for variables within a word
+ */
+static const uint64_t low_masks[6] = {0x5555555555555555ULL, 0x3333333333333333ULL, 0x0f0f0f0f0f0f0f0fULL,
+                                      0x00ff00ff00ff00ffULL, 0x0000ffff0000ffffULL, 0x00000000ffffffffULL};
+
+bit_table make_bit_table(size_t vars) {
+  return bit_table(((1ULL << vars) + 63) / 64, 0);
+}
+
+bool get_entry(const bit_table& table, uint64_t x) {
+  return (table[x / 64] >> (x % 64)) & 1;
+}
+
+void set_entry(bit_table& table, uint64_t x, bool value) {
+  table[x / 64] = (table[x / 64] & ~(1ULL << (x % 64))) | ((uint64_t)value << (x % 64));
+}
+
+/*
+ * out(x) = in(x ^ e_var), 64 entries at a time
+ */
+static void flip_variable(const bit_table& in, bit_table& out, size_t var) {
+  out.resize(in.size());
+  if (var < 6) {
+    size_t shift = 1ULL << var;
+    for (size_t w = 0; w < in.size(); w++) {
+      out[w] = ((in[w] & low_masks[var]) << shift) | ((in[w] >> shift) & low_masks[var]);
+    }
+  } else {
+    size_t stride = 1ULL << (var - 6);
+    for (size_t w = 0; w < in.size(); w++) {
+      out[w] = in[w ^ stride];
+    }
+  }
+}
+
+/*
+ * Finds variables with a constant first derivative and variable pairs with a
+ * vanishing second derivative. Noise violates them only on a small fraction of
+ * entries, so they are detected with a threshold.
+ */
+table_structure find_structure(const bit_table& table, const bit_table& known, size_t vars) {
+  table_structure structure;
+  bit_table table_j, known_j, table_k, known_k, table_jk, known_jk;
+  for (size_t j = 0; j < vars; j++) {
+    flip_variable(table, table_j, j);
+    flip_variable(known, known_j, j);
+
+    uint64_t ones = 0, checked = 0;
+    for (size_t w = 0; w < table.size(); w++) {
+      auto both = known[w] & known_j[w];
+      ones += __builtin_popcountll((table[w] ^ table_j[w]) & both);
+      checked += __builtin_popcountll(both);
+    }
+    if (checked && ones < CONSISTENCY_STRUCTURE_THRESHOLD * checked) {
+      structure.linear.push_back({j, false});
+    } else if (checked && ones > (1 - CONSISTENCY_STRUCTURE_THRESHOLD) * checked) {
+      structure.linear.push_back({j, true});
+    }
+
+    for (size_t k = j + 1; k < vars; k++) {
+      flip_variable(table, table_k, k);
+      flip_variable(known, known_k, k);
+      flip_variable(table_j, table_jk, k);
+      flip_variable(known_j, known_jk, k);
+      ones = 0;
+      checked = 0;
+      for (size_t w = 0; w < table.size(); w++) {
+        auto all = known[w] & known_j[w] & known_k[w] & known_jk[w];
+        ones += __builtin_popcountll((table[w] ^ table_j[w] ^ table_k[w] ^ table_jk[w]) & all);
+        checked += __builtin_popcountll(all);
+      }
+      if (checked && ones < CONSISTENCY_STRUCTURE_THRESHOLD * checked) {
+        structure.separable.push_back({j, k});
+      }
+    }
+  }
+  return structure;
+}
+
+/*
+ * Adds one to the counter of every entry set in violations
+ */
+static void count_violations(const bit_table& violations, std::vector<uint16_t>& counts) {
+  for (size_t w = 0; w < violations.size(); w++) {
+    for (auto word = violations[w]; word; word &= word - 1) {
+      counts[w * 64 + __builtin_ctzll(word)]++;
+    }
+  }
+}
+
+/*
+ * Returns the entries that violate the majority of the structural checks. A
+ * wrong entry violates every check it takes part in, while its neighbours
+ * only violate the checks they share with it.
+ */
+std::vector<uint64_t> find_inconsistent(const bit_table& table, const bit_table& known, size_t vars,
+                                        const table_structure& structure) {
+  std::vector<uint64_t> inconsistent;
+  size_t checks = structure.linear.size() + structure.separable.size();
+  if (!checks) {
+    return inconsistent;
+  }
+  std::vector<uint16_t> counts(1ULL << vars, 0);
+  bit_table violations(table.size()), table_j, known_j, table_k, known_k, table_jk, known_jk;
+
+  for (auto& linear : structure.linear) {
+    flip_variable(table, table_j, linear.first);
+    flip_variable(known, known_j, linear.first);
+    for (size_t w = 0; w < table.size(); w++) {
+      violations[w] = (table[w] ^ table_j[w] ^ (linear.second ? ~0ULL : 0)) & known[w] & known_j[w];
+    }
+    count_violations(violations, counts);
+  }
+
+  for (auto& pair : structure.separable) {
+    flip_variable(table, table_j, pair.first);
+    flip_variable(known, known_j, pair.first);
+    flip_variable(table, table_k, pair.second);
+    flip_variable(known, known_k, pair.second);
+    flip_variable(table_j, table_jk, pair.second);
+    flip_variable(known_j, known_jk, pair.second);
+    for (size_t w = 0; w < table.size(); w++) {
+      violations[w] = (table[w] ^ table_j[w] ^ table_k[w] ^ table_jk[w]) & known[w] & known_j[w] & known_k[w] &
+                      known_jk[w];
+    }
+    count_violations(violations, counts);
+  }
+
+  for (uint64_t x = 0; x < counts.size(); x++) {
+    if (2 * (size_t)counts[x] > checks) {
+      inconsistent.push_back(x);
+    }
+  }
+  return inconsistent;
+}
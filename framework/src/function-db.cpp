@@ -0,0 +1,141 @@
+#include <cpuid.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <plog/Log.h>
+
+#include "../include/function-db.hpp"
+
+/*
+ * Counts the uncore boxes of a kind, e.g. uncore_cha_0 to uncore_cha_27
+ */
+static size_t count_pmus(std::string prefix) {
+  size_t count = 0;
+  DIR* dir = opendir(FUNCTION_DB_SYSFS_PMUS);
+  if (!dir) {
+    return 0;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    std::string name = entry->d_name;
+    if (name.rfind(prefix, 0) == 0 && name.size() > prefix.size() && isdigit(name[prefix.size()])) {
+      count++;
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+/*
+ * Physical cores and sockets from the sysfs topology of every cpu
+ */
+static std::pair<size_t, size_t> count_cores() {
+  std::set<std::pair<int, int>> cores;
+  std::set<int> sockets;
+  for (int cpu = 0;; cpu++) {
+    std::string path = std::string(FUNCTION_DB_SYSFS_CPUS) + "/cpu" + std::to_string(cpu) + "/topology/";
+    std::ifstream package_file(path + "physical_package_id");
+    std::ifstream core_file(path + "core_id");
+    int package, core;
+    if (!(package_file >> package) || !(core_file >> core)) {
+      break;
+    }
+    cores.insert({package, core});
+    sockets.insert(package);
+  }
+  if (cores.empty()) {
+    return {(size_t)sysconf(_SC_NPROCESSORS_CONF), 1};
+  }
+  return {cores.size(), sockets.size()};
+}
+
+std::string function_db_key(int set, bool xeon) {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  char vendor[13] = {0};
+  __get_cpuid(0, &eax, &ebx, &ecx, &edx);
+  memcpy(vendor, &ebx, 4);
+  memcpy(vendor + 4, &edx, 4);
+  memcpy(vendor + 8, &ecx, 4);
+  __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  unsigned family = (eax >> 8) & 0xf;
+  unsigned model = (eax >> 4) & 0xf;
+  if (family == 0x6 || family == 0xf) {
+    model |= ((eax >> 16) & 0xf) << 4;
+  }
+  if (family == 0xf) {
+    family += (eax >> 20) & 0xff;
+  }
+  unsigned stepping = eax & 0xf;
+
+  auto cores = count_cores();
+  size_t uncore = count_pmus("uncore_cha_") + count_pmus("uncore_cbox_");
+  std::stringstream key;
+  key << vendor << "-" << family << "-" << model << "-" << stepping << "_" << cores.first << "c_" << cores.second
+      << "s_" << uncore << "u_set" << set << (xeon ? "_xeon" : "");
+  return key.str();
+}
+
+FunctionDb::FunctionDb(std::string dir) {
+  this->dir = dir;
+  std::filesystem::create_directories(dir);
+}
+
+/*
+ * Reads the entry of a key if there is one, the class count is kept in a
+ * "# classes" comment
+ */
+bool FunctionDb::lookup(std::string key, function_db_entry& entry) {
+  entry.path = this->dir + "/" + key + FUNCTION_DB_EXTENSION;
+  std::ifstream file(entry.path);
+  if (!file.is_open()) {
+    return false;
+  }
+  entry.output_classes = 0;
+  std::stringstream content;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind("# classes ", 0) == 0) {
+      entry.output_classes = std::stoull(line.substr(10));
+    }
+    content << line << "\n";
+  }
+  entry.function = HashFunction::parse(content);
+  return true;
+}
+
+/*
+ * Writes an entry to a temporary file first, so hosts sharing the database
+ * never read a partial entry
+ */
+void FunctionDb::store(std::string key, const HashFunction& function, uint64_t output_classes) {
+  auto path = this->dir + "/" + key + FUNCTION_DB_EXTENSION;
+  auto tmp = path + "." + std::to_string(getpid());
+  write(tmp, key, function, output_classes);
+  std::filesystem::rename(tmp, path);
+}
+
+void FunctionDb::write(std::string path, std::string key, const HashFunction& function, uint64_t output_classes) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  file << "# unscatter function database entry\n# key " << key << "\n# classes " << output_classes << "\n";
+  for (size_t bit = 0; bit < function.bits.size(); bit++) {
+    file << "# relevant bits h[" << bit << "]";
+    for (auto b : function.relevant_bits(bit)) {
+      file << " " << b;
+    }
+    file << "\n";
+  }
+  for (auto& bit : function.bits) {
+    file << HashFunction::format_bit(bit) << "\n";
+  }
+  if (!file) {
+    std::throw_with_nested(std::runtime_error(path + " could not be written"));
+  }
+}
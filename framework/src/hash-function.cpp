@@ -0,0 +1,477 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <exception>
+
+#include "../include/hash-function.hpp"
+#include "../include/truth-table.hpp"
+
+/*
+ * Removes leading and trailing whitespace
+ */
+static std::string trim(std::string s) {
+  auto begin = s.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  auto end = s.find_last_not_of(" \t\r\n");
+  return s.substr(begin, end - begin + 1);
+}
+
+/*
+ * Splits a string at every character contained in delims
+ */
+static std::vector<std::string> split(std::string s, std::string delims) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  for (size_t i = 0; i <= s.size(); i++) {
+    if (i == s.size() || delims.find(s[i]) != std::string::npos) {
+      parts.push_back(trim(s.substr(begin, i - begin)));
+      begin = i + 1;
+    }
+  }
+  return parts;
+}
+
+/*
+ * Parses a variable, accepted are x12, x[12] and 12
+ */
+static uint64_t parse_variable(std::string var) {
+  if (!var.empty() && var[0] == 'x') {
+    var = var.substr(1);
+  }
+  if (var.size() >= 2 && var.front() == '[' && var.back() == ']') {
+    var = var.substr(1, var.size() - 2);
+  }
+  size_t pos = 0;
+  uint64_t idx = 0;
+  try {
+    idx = std::stoull(var, &pos);
+  } catch (...) {
+    pos = 0;
+  }
+  if (pos != var.size() || idx >= 64) {
+    std::throw_with_nested(std::runtime_error("Invalid variable in hash function: " + var));
+  }
+  return idx;
+}
+
+/*
+ * Recursive descent over an expression with python precedence, ~ binds
+ * tightest, then & (or *), ^ (or +) and |. Only the lowest bit of every value
+ * matters, which is what python computes for 0 and 1 and a final & 1.
+ */
+class ExpressionParser {
+ private:
+  const std::string& text;
+  const std::vector<uint64_t>& bits;
+  const std::map<std::string, expression>& names;
+  size_t pos = 0;
+
+  char peek() {
+    while (this->pos < this->text.size() && std::isspace(this->text[this->pos])) {
+      this->pos++;
+    }
+    return this->pos < this->text.size() ? this->text[this->pos] : '\0';
+  }
+
+  void fail(std::string what) {
+    std::throw_with_nested(std::runtime_error("Invalid expression in hash function, " + what + " at " +
+                                              std::to_string(this->pos) + ": " + this->text));
+  }
+
+  uint64_t number() {
+    size_t begin = this->pos;
+    while (this->pos < this->text.size() && std::isdigit(this->text[this->pos])) {
+      this->pos++;
+    }
+    if (begin == this->pos) {
+      fail("expected a number");
+    }
+    return std::stoull(this->text.substr(begin, this->pos - begin));
+  }
+
+  void operand(expression& out) {
+    char c = peek();
+    if (c == '~') {
+      this->pos++;
+      operand(out);
+      out.push_back(expression_token{'~', 0});
+    } else if (c == '(') {
+      this->pos++;
+      disjunction(out);
+      if (peek() != ')') {
+        fail("expected )");
+      }
+      this->pos++;
+    } else if (std::isdigit(c)) {
+      out.push_back(expression_token{'c', number() & 0x1});
+    } else if (c == 'x') {
+      this->pos++;
+      bool bracket = peek() == '[';
+      if (bracket) {
+        this->pos++;
+        peek();
+      }
+      auto var = number();
+      if (bracket) {
+        if (peek() != ']') {
+          fail("expected ]");
+        }
+        this->pos++;
+      }
+      if (!this->bits.empty()) {
+        if (var >= this->bits.size()) {
+          fail("variable beyond the relevant bits");
+        }
+        var = this->bits[var];
+      }
+      if (var >= 64) {
+        fail("variable beyond 64 bits");
+      }
+      out.push_back(expression_token{'v', var});
+    } else if (std::isalpha(c) || c == '_') {
+      size_t begin = this->pos;
+      while (this->pos < this->text.size() && (std::isalnum(this->text[this->pos]) || this->text[this->pos] == '_')) {
+        this->pos++;
+      }
+      auto name = this->names.find(this->text.substr(begin, this->pos - begin));
+      if (name == this->names.end()) {
+        this->pos = begin;
+        fail("unknown name");
+      }
+      out.insert(out.end(), name->second.begin(), name->second.end());
+    } else {
+      fail("expected an operand");
+    }
+  }
+
+  void conjunction(expression& out) {
+    operand(out);
+    while (peek() == '&' || peek() == '*') {
+      this->pos++;
+      operand(out);
+      out.push_back(expression_token{'&', 0});
+    }
+  }
+
+  void exclusive(expression& out) {
+    conjunction(out);
+    while (peek() == '^' || peek() == '+') {
+      this->pos++;
+      conjunction(out);
+      out.push_back(expression_token{'^', 0});
+    }
+  }
+
+  void disjunction(expression& out) {
+    exclusive(out);
+    while (peek() == '|') {
+      this->pos++;
+      exclusive(out);
+      out.push_back(expression_token{'|', 0});
+    }
+  }
+
+ public:
+  ExpressionParser(const std::string& text, const std::vector<uint64_t>& bits,
+                   const std::map<std::string, expression>& names)
+      : text(text), bits(bits), names(names) {}
+
+  expression parse() {
+    expression out;
+    disjunction(out);
+    if (peek() != '\0') {
+      fail("unexpected character");
+    }
+    return out;
+  }
+};
+
+/*
+ * Parses a boolean expression, variables x[i] are mapped to bits[i] if bits
+ * are given and names are substituted by their expressions
+ */
+expression HashFunction::parse_expression(std::string text, const std::vector<uint64_t>& bits,
+                                          const std::map<std::string, expression>& names) {
+  return ExpressionParser(text, bits, names).parse();
+}
+
+/*
+ * Evaluates the expression for all assignments of its variables, 64 at a time
+ * in the bits of a word, and turns the truth table into anf with the Moebius
+ * transform
+ */
+anf_bit HashFunction::expression_to_anf(const expression& expr) {
+  std::vector<uint64_t> vars;
+  for (auto& token : expr) {
+    if (token.op == 'v' && std::find(vars.begin(), vars.end(), token.value) == vars.end()) {
+      vars.push_back(token.value);
+    }
+  }
+  if (vars.size() > HASH_FUNCTION_MAX_EXPRESSION_VARIABLES) {
+    std::throw_with_nested(std::runtime_error("Expression in hash function has more than " +
+                                              std::to_string(HASH_FUNCTION_MAX_EXPRESSION_VARIABLES) + " variables"));
+  }
+  static const uint64_t low_patterns[6] = {0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+                                           0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL};
+  size_t words = vars.size() > 6 ? 1ULL << (vars.size() - 6) : 1;
+  std::vector<uint64_t> table(words);
+  std::vector<uint64_t> stack;
+  for (size_t w = 0; w < words; w++) {
+    stack.clear();
+    for (auto& token : expr) {
+      uint64_t a, b;
+      switch (token.op) {
+        case 'v': {
+          size_t i = std::find(vars.begin(), vars.end(), token.value) - vars.begin();
+          stack.push_back(i < 6 ? low_patterns[i] : ((w >> (i - 6)) & 0x1) ? ~0ULL : 0);
+          break;
+        }
+        case 'c':
+          stack.push_back(token.value ? ~0ULL : 0);
+          break;
+        case '~':
+          stack.back() = ~stack.back();
+          break;
+        default:
+          b = stack.back();
+          stack.pop_back();
+          a = stack.back();
+          stack.back() = token.op == '&' ? a & b : token.op == '^' ? a ^ b : a | b;
+      }
+    }
+    table[w] = stack.back();
+  }
+  if (vars.size() < 6) {
+    table[0] &= (1ULL << (1ULL << vars.size())) - 1;
+  }
+
+  // Moebius transform, within the words for the low variables and between
+  // the words for the others
+  for (size_t i = 0; i < std::min<size_t>(vars.size(), 6); i++) {
+    for (auto& word : table) {
+      word ^= (word & ~low_patterns[i]) << (1ULL << i);
+    }
+  }
+  for (size_t i = 6; i < vars.size(); i++) {
+    for (size_t w = 0; w < words; w++) {
+      if ((w >> (i - 6)) & 0x1) {
+        table[w] ^= table[w ^ (1ULL << (i - 6))];
+      }
+    }
+  }
+
+  anf_bit bit{0, {}, false};
+  for (size_t w = 0; w < words; w++) {
+    for (auto coefficients = table[w]; coefficients; coefficients &= coefficients - 1) {
+      uint64_t m = w * 64 + __builtin_ctzll(coefficients);
+      uint64_t mask = 0;
+      for (size_t i = 0; i < vars.size(); i++) {
+        mask |= ((m >> i) & 0x1) << vars[i];
+      }
+      if (mask == 0) {
+        bit.constant = true;
+      } else if (__builtin_popcountll(mask) == 1) {
+        bit.linear |= mask;
+      } else {
+        bit.monomials.push_back(mask);
+      }
+    }
+  }
+  return bit;
+}
+
+anf_bit HashFunction::parse_bit(std::string line) {
+  anf_bit bit{0, {}, false};
+  line = trim(line);
+  if (line.rfind("0x", 0) == 0) {
+    bit.linear = std::stoull(line, nullptr, 16);
+    return bit;
+  }
+  if (line.find_first_of("~|(") != std::string::npos) {
+    return expression_to_anf(parse_expression(line));
+  }
+  for (auto term : split(line, "+^")) {
+    if (term == "1") {
+      bit.constant = !bit.constant;
+      continue;
+    }
+    if (term == "0") {
+      continue;
+    }
+    if (term.size() >= 2 && term.front() == '(' && term.back() == ')') {
+      term = trim(term.substr(1, term.size() - 2));
+    }
+    uint64_t mask = 0;
+    for (auto factor : split(term, "*&")) {
+      mask |= 1ULL << parse_variable(factor);
+    }
+    // Monomials are xor-ed, so a monomial that appears twice cancels out
+    if (__builtin_popcountll(mask) == 1) {
+      bit.linear ^= mask;
+    } else {
+      auto it = std::find(bit.monomials.begin(), bit.monomials.end(), mask);
+      if (it != bit.monomials.end()) {
+        bit.monomials.erase(it);
+      } else {
+        bit.monomials.push_back(mask);
+      }
+    }
+  }
+  return bit;
+}
+
+/*
+ * Inverse of parse_bit, linear bits are written as mask
+ */
+std::string HashFunction::format_bit(const anf_bit& bit) {
+  if (bit.monomials.empty() && !bit.constant) {
+    std::stringstream mask;
+    mask << "0x" << std::hex << bit.linear;
+    return mask.str();
+  }
+  std::vector<std::string> terms;
+  for (auto monomial : bit.monomials) {
+    std::string term;
+    for (uint64_t i = 0; i < 64; i++) {
+      if ((monomial >> i) & 0x1) {
+        term += (term.empty() ? "x" : "*x") + std::to_string(i);
+      }
+    }
+    terms.push_back(term);
+  }
+  for (uint64_t i = 0; i < 64; i++) {
+    if ((bit.linear >> i) & 0x1) {
+      terms.push_back("x" + std::to_string(i));
+    }
+  }
+  if (bit.constant) {
+    terms.push_back("1");
+  }
+  std::string line;
+  for (auto& term : terms) {
+    line += (line.empty() ? "" : " + ") + term;
+  }
+  return line;
+}
+
+HashFunction HashFunction::parse(std::istream& in) {
+  HashFunction function;
+  std::string line;
+  while (getline(in, line)) {
+    line = trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    function.bits.push_back(parse_bit(line));
+  }
+  if (function.bits.empty()) {
+    std::throw_with_nested(std::runtime_error("Hash function does not contain any output bit"));
+  }
+  return function;
+}
+
+/*
+ * Parses the solution of the minimizer, either formula = lambda x: <expr> or
+ * def formula(x): with assignments y<k> = <expr> and return <expr>
+ */
+HashFunction HashFunction::parse_solution(std::istream& in, const std::vector<uint64_t>& bits) {
+  std::map<std::string, expression> names;
+  std::string line;
+  while (getline(in, line)) {
+    line = trim(line);
+    auto lambda = line.find("lambda x:");
+    if (line.rfind("formula", 0) == 0 && lambda != std::string::npos) {
+      HashFunction function;
+      function.bits.push_back(expression_to_anf(parse_expression(line.substr(lambda + 9), bits, names)));
+      return function;
+    }
+    if (line.rfind("return ", 0) == 0) {
+      HashFunction function;
+      function.bits.push_back(expression_to_anf(parse_expression(line.substr(7), bits, names)));
+      return function;
+    }
+    auto assign = line.find('=');
+    if (line.rfind("def ", 0) != 0 && assign != std::string::npos) {
+      names[trim(line.substr(0, assign))] = parse_expression(line.substr(assign + 1), bits, names);
+    }
+  }
+  std::throw_with_nested(std::runtime_error("Solution does not contain a formula"));
+}
+
+HashFunction::HashFunction() {}
+
+HashFunction::HashFunction(std::string path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  auto name = std::filesystem::path(path).filename().string();
+  if (name.size() > 4 && name.substr(name.size() - 4) == ".sol") {
+    if (name.rfind("bit_", 0) != 0) {
+      std::throw_with_nested(std::runtime_error(path + ": solutions have to be named bit_<n>.sol"));
+    }
+    auto bits_file = read_bits_file((std::filesystem::path(path).parent_path() / "bits.csv").string());
+    auto bit = std::stoull(name.substr(4));
+    if (bit >= bits_file.size()) {
+      std::throw_with_nested(std::runtime_error(path + ": bits.csv has no line " + std::to_string(bit)));
+    }
+    this->bits = parse_solution(file, bits_file[bit]).bits;
+    this->output_bit = bit;
+    return;
+  }
+  this->bits = parse(file).bits;
+}
+
+/*
+ * Evaluates a single output bit for an address
+ */
+uint64_t HashFunction::eval_bit(size_t bit, pointer addr) const {
+  const anf_bit& f = this->bits[bit];
+  uint64_t out = __builtin_parityll(addr & f.linear) ^ f.constant;
+  for (auto monomial : f.monomials) {
+    out ^= (addr & monomial) == monomial;
+  }
+  return out;
+}
+
+/*
+ * Evaluates all output bits, bit i of the result is output bit i
+ */
+uint64_t HashFunction::eval(pointer addr) const {
+  uint64_t out = 0;
+  for (size_t i = 0; i < this->bits.size(); i++) {
+    out |= eval_bit(i, addr) << i;
+  }
+  return out;
+}
+
+/*
+ * Returns the address bits an output bit depends on
+ */
+std::vector<uint64_t> HashFunction::relevant_bits(size_t bit) const {
+  uint64_t mask = this->bits[bit].linear;
+  for (auto monomial : this->bits[bit].monomials) {
+    mask |= monomial;
+  }
+  std::vector<uint64_t> relevant;
+  for (uint64_t i = 0; i < 64; i++) {
+    if ((mask >> i) & 1) {
+      relevant.push_back(i);
+    }
+  }
+  return relevant;
+}
+
+bool HashFunction::is_linear() const {
+  for (auto& bit : this->bits) {
+    if (!bit.monomials.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
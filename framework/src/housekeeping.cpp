@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <sched.h>
+#include <unistd.h>
+
+#include "../include/housekeeping.hpp"
+
+int Housekeeping::measurement_core = 0;
+int Housekeeping::housekeeping_core = -1;
+std::mutex Housekeeping::writers_lock;
+std::vector<HousekeepingWriter*> Housekeeping::writers;
+std::atomic<uint64_t> Housekeeping::failed_writes{0};
+
+/*
+ * A negative housekeeping core allows every core but the measurement core
+ */
+void Housekeeping::set_cores(int measurement_core, int housekeeping_core) {
+  Housekeeping::measurement_core = measurement_core;
+  Housekeeping::housekeeping_core = housekeeping_core;
+}
+
+/*
+ * Pins the calling thread to the housekeeping core
+ */
+void Housekeeping::pin() {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (housekeeping_core >= 0) {
+    CPU_SET(housekeeping_core, &mask);
+  } else {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long core = 0; core < cores; core++) {
+      if (core != measurement_core || cores == 1) {
+        CPU_SET(core, &mask);
+      }
+    }
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &mask)) {
+    PLOG_WARNING << "Could not pin housekeeping thread";
+  }
+}
+
+/*
+ * Writers are closed at exit in case the process ends without destroying them
+ */
+void Housekeeping::register_writer(HousekeepingWriter* writer) {
+  static bool registered = false;
+  std::lock_guard<std::mutex> guard(writers_lock);
+  if (!registered) {
+    std::atexit(Housekeeping::close_writers);
+    registered = true;
+  }
+  writers.push_back(writer);
+}
+
+void Housekeeping::unregister_writer(HousekeepingWriter* writer) {
+  std::lock_guard<std::mutex> guard(writers_lock);
+  writers.erase(std::remove(writers.begin(), writers.end(), writer), writers.end());
+}
+
+/*
+ * Drains the writers that are still open, newest first
+ */
+void Housekeeping::close_writers() {
+  std::vector<HousekeepingWriter*> open;
+  {
+    std::lock_guard<std::mutex> guard(writers_lock);
+    open = writers;
+  }
+  for (auto it = open.rbegin(); it != open.rend(); it++) {
+    (*it)->close();
+  }
+}
+
+/*
+ * Formats an entry as "addr, class, margin", unmapped entries get a - as class
+ */
+size_t format_dump_record(char* out, const dump_record& record) {
+  char* end = out + HOUSEKEEPING_MAX_RECORD_BYTES;
+  char* pos = std::to_chars(out, end, record.addr).ptr;
+  *pos++ = ',';
+  *pos++ = ' ';
+  if (record.mapped) {
+    pos = std::to_chars(pos, end, record.value).ptr;
+  } else {
+    *pos++ = '-';
+  }
+  *pos++ = ',';
+  *pos++ = ' ';
+  pos = std::to_chars(pos, end, record.mapped ? record.margin : 0).ptr;
+  *pos++ = '\n';
+  return pos - out;
+}
+
+AsyncLogAppender::AsyncLogAppender(plog::IAppender* next) {
+  this->next = next;
+  this->stopped = false;
+  this->thread = std::thread(&AsyncLogAppender::run, this);
+}
+
+/*
+ * Prints all queued records
+ */
+AsyncLogAppender::~AsyncLogAppender() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopped = true;
+  }
+  this->wakeup.notify_all();
+  this->thread.join();
+}
+
+/*
+ * Records are recreated on the housekeeping thread, their timestamp is the
+ * time they are printed
+ */
+void AsyncLogAppender::forward(const log_entry& entry) {
+  plog::Record record(entry.severity, entry.func, entry.line, entry.file, entry.object, entry.instance);
+  record << entry.message;
+  this->next->write(record);
+}
+
+void AsyncLogAppender::write(const plog::Record& record) {
+  log_entry entry{record.getSeverity(), record.getFunc(), record.getLine(), record.getFile(),
+                  record.getObject(), record.getInstanceId(), record.getMessage()};
+  std::unique_lock<std::mutex> guard(this->lock);
+  if (entry.severity <= plog::error) {
+    // Keep the order and print before a possible exit
+    while (!this->queue.empty()) {
+      forward(this->queue.front());
+      this->queue.pop_front();
+    }
+    forward(entry);
+    return;
+  }
+  this->queue.push_back(entry);
+  guard.unlock();
+  this->wakeup.notify_one();
+}
+
+void AsyncLogAppender::run() {
+  Housekeeping::pin();
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (true) {
+    this->wakeup.wait(guard, [this] { return this->stopped || !this->queue.empty(); });
+    while (!this->queue.empty()) {
+      auto entry = this->queue.front();
+      this->queue.pop_front();
+      guard.unlock();
+      forward(entry);
+      guard.lock();
+    }
+    if (this->stopped) {
+      break;
+    }
+  }
+}
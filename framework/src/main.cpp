@@ -17,6 +17,7 @@
 #include <boost/tokenizer.hpp>
 #include <cstdlib>
 #include <filesystem>
+#include <random>
 
 
 #include <plog/Log.h>
@@ -32,7 +33,43 @@
 #include "../include/utils.hpp"
 #include "../include/framework.hpp"
 #include "../include/oracle.hpp"
+#include "../include/hash-function.hpp"
+#include "../include/metrics.hpp"
+#include "../include/progress.hpp"
+#include "../include/housekeeping.hpp"
+#include "../include/truth-table.hpp"
+#include "../include/verify.hpp"
+#include "../include/function-db.hpp"
 
+/*
+* Parses a comma separated list of hex ranges like 0xa0000-0xfffff
+*/
+static boost::icl::interval_set<pointer> parse_ranges(std::string ranges){
+  boost::icl::interval_set<pointer> set;
+  typedef boost::tokenizer<boost::char_separator<char>> Tokenizer;
+  Tokenizer tok(ranges, boost::char_separator<char>(","));
+  for(auto range : tok){
+    auto dash = range.find("-");
+    if(dash == std::string::npos){
+      std::throw_with_nested(std::runtime_error("Invalid range " + range));
+    }
+    auto lower = std::stoull(range.substr(0, dash), nullptr, 16);
+    auto upper = std::stoull(range.substr(dash + 1), nullptr, 16);
+    set += boost::icl::discrete_interval<pointer>::closed(lower, upper);
+  }
+  return set;
+}
+
+/*
+* Builds the framework for a concrete address pool and oracle type
+*/
+template <typename AddrT, typename OracleT>
+static Framework* make_framework(bool naive, int core, AddrT* addr, OracleT* oracle){
+  if(naive){
+    return new NaiveFramework<AddrT,OracleT>(core,addr,oracle);
+  }
+  return new BitwiseFramework<AddrT,OracleT>(core,addr,oracle);
+}
 
 int main(int argc, char** argv) {
   // Parse command line arguments
@@ -41,8 +78,11 @@ int main(int argc, char** argv) {
   int core = 0;
   app.add_option("-c,--core", core, "Core to pin framwork to");
 
+  int housekeeping_core = -1;
+  app.add_option("--housekeeping-core", housekeeping_core, "Core for I/O, logging and reporting threads (any but the framework core if not given)");
+
   int set = 0;
-  app.add_option("-s,--set-option", set, "Set currently implemented frameworks 0=Slice Direct, 1=Slice Indirect, 2=Utag Indirect, 3=DRAM Indirect");
+  app.add_option("-s,--set-option", set, "Set currently implemented frameworks 0=Slice Direct, 1=Slice Indirect, 2=Utag Indirect, 3=DRAM Indirect, 4=Simulated Direct, 5=Simulated Indirect");
 
   int output_classes = 0;
   app.add_option("-o,--output-classes", output_classes, "Number of output classes, (if not given then determined automatically)");
@@ -50,6 +90,9 @@ int main(int argc, char** argv) {
   int tresh_oracle = 9;
   app.add_option("-t,--tresh-oracle", tresh_oracle, "Treshold of oracle in percent default 90%");
 
+  int weak_confidence = 0;
+  app.add_option("--weak-confidence", weak_confidence, "Accept decisions with more votes than this without retrying, they get a low margin in the dump (0 disables)");
+
   int bit_limit_hi = 64;
   app.add_option("-u,--bit-limit-upper", bit_limit_hi, "Bit limit for highest bit that gets dumped");
   
@@ -59,126 +102,579 @@ int main(int argc, char** argv) {
   std::string input_bits_file = "";
   app.add_option("-r,--relevant-input-bits", input_bits_file, "File containing the relevant input bits");
 
+  std::string output_dir = "measurements";
+  app.add_option("--output-dir", output_dir, "Directory for the measurement results, it must not exist yet");
+
+  std::string shard = "";
+  app.add_option("--shard", shard, "Dump only part i/N of every table, unscatter-merge assembles the shards of identical machines");
+
+  bool tile = false;
+  app.add_flag("--tile",tile,"Dump every assignment of the relevant bits outside the bit limits as its own table, see tiles.csv");
+
+  bool relabel = false;
+  app.add_flag("--relabel",relabel,"Map the classes of indirect oracles to binary codes and dump them bitwise if the function is linear");
+
+  bool two_pass = false;
+  app.add_flag("--two-pass",two_pass,"Measure every entry cheaply and only inconsistent entries robustly (direct oracles only)");
+
+  int first_pass_calls = 1;
+  app.add_option("--first-pass-calls",first_pass_calls,"Oracle calls per entry in the cheap pass of a two pass dump");
+
+  bool pla = false;
+  app.add_flag("--pla",pla,"Write every dump as espresso input (.pla) as well, unmapped entries are don't cares");
+
+  bool pla_binary = false;
+  app.add_flag("--pla-binary",pla_binary,"Encode the classes of tables of all output bits in binary instead of one hot");
+
+  uint32_t pla_min_margin = 0;
+  app.add_option("--pla-min-margin",pla_min_margin,"Entries with a vote margin below this are don't cares in the PLA");
+
   bool dry_run = false;
   app.add_flag("--dry-run",dry_run,"Perform a dry run without measurements.");
 
+  std::string verify_file = "";
+  app.add_option("--verify",verify_file,"Check a candidate function (masks, anf, expressions or a bit_<n>.sol of the minimizer) on random addresses instead of dumping");
+
+  size_t verify_samples = VERIFY_SAMPLES;
+  app.add_option("--verify-samples",verify_samples,"Random addresses measured by --verify");
+
+  std::string function_db = "";
+  app.add_option("--function-db",function_db,"Directory of recovered functions, a stored function of the same kind of machine is only verified, functions that pass --verify are stored");
+
   bool is_xeon = false;
   app.add_flag("--xeon",is_xeon,"Enable if tested processor is an Intel Xeon chip");
 
-  //std::string measurement_dir = "";
-  //app.add_option("-m,--measurement-result-dir", input_bits_file, "Directory for the measurement results");
-  
+  int phys_window_bits = 0;
+  app.add_option("--phys-window-bits", phys_window_bits, "Map /dev/mem in windows of 2^n bytes on demand instead of all at once (e.g. 21 or 30)");
+
+  int phys_windows = PHYS_WINDOW_COUNT;
+  app.add_option("--phys-windows", phys_windows, "Number of /dev/mem windows that stay mapped");
+
+  bool numa = false;
+  app.add_flag("--numa", numa, "Measure the addresses of every NUMA node on a core of that node");
+
+  int virt_bits = 30;
+  app.add_option("--virt-bits", virt_bits, "Bits of virtual addresses the utag framework measures on");
+
+  int virt_alias_bits = 0;
+  app.add_option("--virt-alias-bits", virt_alias_bits, "Back the virtual addresses with aliases of one 2^n byte region instead of distinct memory (raised to fit the mapping limit)");
+
+  std::string virt_backing_name = "auto";
+  app.add_option("--virt-backing", virt_backing_name, "Pages backing the virtual addresses of the utag framework: auto, 4k, thp, 2m or 1g");
+
+  bool virt_lazy = false;
+  app.add_flag("--virt-lazy", virt_lazy, "Populate the virtual addresses on first access instead of at startup");
+
+  std::string sim_function_file = "";
+  app.add_option("--sim-function", sim_function_file, "File containing the simulated hash function, one xor mask or anf per output bit");
+
+  int sim_bits = 34;
+  app.add_option("--sim-bits", sim_bits, "Bits of simulated physical memory");
+
+  std::string sim_holes = "0xa0000-0xfffff,0xc0000000-0xffffffff";
+  app.add_option("--sim-holes", sim_holes, "Comma separated hex ranges that are not part of the simulated memory");
+
+  sim_noise noise{0, 0, 0, 0, 0, 0};
+  app.add_option("--sim-flip-prob", noise.flip_probability, "Probability that the simulated oracle flips an output bit");
+  app.add_option("--sim-burst-prob", noise.burst_probability, "Probability that a burst of errors starts on a call");
+  app.add_option("--sim-burst-length", noise.burst_length, "Number of calls a burst of errors lasts");
+  app.add_option("--sim-burst-flip-prob", noise.burst_flip_probability, "Flip probability during a burst of errors");
+  app.add_option("--sim-drift", noise.drift, "Increase of the flip probability per million calls");
+  app.add_option("--sim-latency", noise.latency_ns, "Latency of a simulated oracle call in ns");
+
+  uint64_t sim_seed = 0;
+  app.add_option("--sim-seed", sim_seed, "Seed for the simulated noise (random if not given)");
+
+  uint64_t seed = 0;
+  app.add_option("--seed", seed, "Seed for the address selection (random if not given)");
+
+  std::string multi = "";
+  app.add_option("--multi", multi, "Comma separated set options measured together on one address pool instead of -s, e.g. 0,3 or 4,5");
+
+  std::string record_file = "";
+  app.add_option("--record", record_file, "Record every raw oracle response to this trace file");
+
+  std::string replay_file = "";
+  app.add_option("--replay", replay_file, "Answer oracle calls from a recorded trace instead of measuring");
+
+  unsigned metrics_interval = 60;
+  app.add_option("--metrics-interval", metrics_interval, "Seconds between updates of <output dir>/metrics.prom, 0 disables periodic export");
+
+  unsigned progress_interval = 10;
+  app.add_option("--progress-interval", progress_interval, "Seconds between progress reports, 0 disables them");
+
   // Parse command line ars
   CLI11_PARSE(app,argc,argv);
 
-  // Init logging
+  // Init logging, records are printed by a housekeeping thread
+  Housekeeping::set_cores(core, housekeeping_core);
   static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
-  plog::init(plog::debug, &consoleAppender);
+  static AsyncLogAppender asyncAppender(&consoleAppender);
+  plog::init(plog::debug, &asyncAppender);
+
+  // Frameworks measured together on one address pool
+  std::vector<int> multi_sets;
+  if(multi != ""){
+    typedef boost::tokenizer<boost::char_separator<char>> Tokenizer;
+    for(auto elem : Tokenizer(multi, boost::char_separator<char>(","))){
+      multi_sets.push_back(std::stoi(elem));
+    }
+    if(record_file != "" || replay_file != "" || input_bits_file != "" || verify_file != ""){
+      PLOG_FATAL << "--multi cannot be combined with --record, --replay, -r or --verify";
+      exit(1);
+    }
+    set = *std::min_element(multi_sets.begin(), multi_sets.end());
+  }
 
-  // Check if started as root
-  if (geteuid()) {
+  // Parse the candidate function before measuring anything
+  HashFunction verify_function;
+  if(verify_file != ""){
+    try{
+      verify_function = HashFunction(verify_file);
+    }catch (const std::exception& e){
+      PLOG_FATAL << "Candidate function " << verify_file << ": " << e.what();
+      exit(1);
+    }
+    if(verify_function.output_bit >= 0){
+      PLOG_INFO << "Verifying " << verify_file << " against output bit " << verify_function.output_bit;
+    }else{
+      PLOG_INFO << "Verifying " << verify_file << " with " << verify_function.bits.size() << " output bits";
+    }
+  }
+
+  // A function recovered on the same kind of machine only has to be verified
+  std::unique_ptr<FunctionDb> db;
+  std::string db_key;
+  function_db_entry db_entry;
+  bool db_hit = false;
+  if(function_db != ""){
+    if(multi != ""){
+      PLOG_FATAL << "--function-db cannot be combined with --multi";
+      exit(1);
+    }
+    db.reset(new FunctionDb(function_db));
+    db_key = function_db_key(set, is_xeon);
+    try{
+      db_hit = verify_file == "" && db->lookup(db_key, db_entry);
+    }catch (const std::exception& e){
+      PLOG_WARNING << "Function database entry " << db_entry.path << " is unreadable, recovering the function: " << e.what();
+    }
+    if(db_hit){
+      PLOG_INFO << "Function database entry " << db_entry.path << " matches, verifying it instead of recovering";
+      verify_function = db_entry.function;
+    }else if(verify_file == ""){
+      PLOG_INFO << "Function database has no entry for " << db_key;
+    }
+  }
+
+  // Check if started as root, simulated frameworks and replays run without privileges
+  if (geteuid() && set < 4 && replay_file == "") {
     PLOG_FATAL << "Framework must be run as root";
     exit(1);
   }
 
+  // Shards split every table between identical machines or processes
+  shard_spec shard_selected{0, 1};
+  if(shard != ""){
+    try{
+      shard_selected = parse_shard(shard);
+    }catch (const std::exception& e){
+      PLOG_FATAL << e.what();
+      exit(1);
+    }
+    if(two_pass || multi != ""){
+      PLOG_FATAL << "--shard cannot be combined with --two-pass or --multi";
+      exit(1);
+    }
+  }
+
+  if(numa && set == 0){
+    // The slice counters are read through the MSRs of the socket of core 0
+    PLOG_FATAL << "--numa cannot be combined with set 0, the slice counters only count the socket of core 0";
+    exit(1);
+  }
+
+  if(virt_alias_bits < 0){
+    PLOG_FATAL << "--virt-alias-bits needs regions of at least " << VIRT_MIN_BITS << " bits, or 0 for distinct memory";
+    exit(1);
+  }
+
+  if(first_pass_calls < 1){
+    PLOG_FATAL << "--first-pass-calls needs at least 1 oracle call per entry";
+    exit(1);
+  }
+
   // Check if output dir exists
-  if(std::filesystem::is_directory("measurements")){
-    PLOG_INFO << "Delete ./measurements folde and rerun unscatter to discard previous results";
+  if(std::filesystem::is_directory(output_dir)){
+    PLOG_INFO << "Delete " << output_dir << " folder and rerun unscatter to discard previous results";
     exit(1);
   }else{
-    PLOG_INFO << "Creating ./measurement folder";
-    std::filesystem::create_directory("measurements");
+    PLOG_INFO << "Creating " << output_dir << " folder";
+    std::filesystem::create_directories(output_dir);
+  }
+  if(shard_selected.shards > 1){
+    PLOG_INFO << "Dumping shard " << shard_selected.shard << " of " << shard_selected.shards;
   }
   
   // Time execution
   auto start = std::chrono::high_resolution_clock::now();
+  Metrics::set_phase(PHASE_SETUP);
+  std::unique_ptr<MetricsExporter> exporter;
+  if(metrics_interval){
+    exporter.reset(new MetricsExporter(output_dir + "/metrics.prom", metrics_interval));
+  }
+  std::unique_ptr<ProgressReporter> progress;
+  if(progress_interval){
+    progress.reset(new ProgressReporter(progress_interval));
+  }
 
 
   Oracle* oracle;
   IAddr* addr;
   Framework* framework;
-  switch (set)
-  {
-  case 0:
-    PLOG_INFO << "Measuring cache slices with performance counters";
-    oracle = new SliceOracle(10,tresh_oracle,is_xeon);
-    addr = new PhysAddr();
-    framework = new BitwiseFramework(core,addr,oracle);
-    break;
-  case 1: 
-    PLOG_INFO << "Measuring cache slices with timing";
-    addr = new PhysAddr();
-    oracle = new SliceTimingOracle(10,tresh_oracle,addr);
-    framework = new BitwiseFramework(core,addr,oracle);
-    break;
-  case 2:
-    PLOG_INFO << "Measuring utag hash function";
-    addr = new VirtAddr(30);
-    oracle = new UtagOracle(10,tresh_oracle,addr);
-    framework = new NaiveFramework(core,addr,oracle);
-    output_classes = oracle->output_classes;
-    break;
-  case 3: 
-    PLOG_INFO << "Measuring DRAM addressing function";
-    addr = new PhysAddr();
-    oracle = new DramaOracle(10,tresh_oracle,addr);
-    framework = new NaiveFramework(core,addr,oracle);
-    output_classes = oracle->output_classes;
-    break;
-  default:
-    PLOG_ERROR << "Invalid oracle selected current choices 0-3";
+  MultiFramework* multi_framework = nullptr;
+  bool naive = false;
+  if(multi_sets.size()){
+    bool simulated = set >= 4;
+    if(simulated){
+      if(sim_function_file == ""){
+        PLOG_FATAL << "Simulated frameworks require a hash function given with --sim-function";
+        exit(1);
+      }
+      if(sim_seed == 0){
+        sim_seed = std::random_device()();
+      }
+      addr = new SimAddr(sim_bits, parse_ranges(sim_holes));
+    }else{
+      addr = new PhysAddr(phys_window_bits, phys_windows);
+    }
+    multi_framework = new MultiFramework(addr);
+    for(auto s : multi_sets){
+      Oracle* sub_oracle;
+      bool sub_naive = false;
+      std::string name;
+      if((s >= 4) != simulated || s == 2 || s < 0 || s > 5){
+        PLOG_FATAL << "--multi needs frameworks on physical addresses (0,1,3) or simulated ones (4,5), " << s << " cannot be combined";
+        exit(1);
+      }
+      switch (s)
+      {
+      case 0:
+        sub_oracle = new SliceOracle(10,tresh_oracle,is_xeon);
+        name = "slice";
+        break;
+      case 1:
+        sub_oracle = new SliceTimingOracle(10,tresh_oracle,addr);
+        name = "slice-timing";
+        break;
+      case 3:
+        sub_oracle = new DramaOracle(10,tresh_oracle,addr);
+        sub_naive = true;
+        name = "dram";
+        break;
+      default:
+        sub_oracle = new SimOracle(10,tresh_oracle,HashFunction(sim_function_file),noise,sim_seed);
+        sub_naive = s == 5;
+        name = sub_naive ? "sim-indirect" : "sim-direct";
+      }
+      PLOG_INFO << "Measuring " << name << " on the shared address pool";
+      auto sub_framework = make_framework(sub_naive,core,addr,sub_oracle);
+      sub_framework->output_dir = output_dir + "/" + name;
+      std::filesystem::create_directory(sub_framework->output_dir);
+      if(sub_naive){
+        sub_framework->output_classes = sub_oracle->output_classes;
+      }else if(output_classes){
+        sub_oracle->output_classes = output_classes;
+        sub_framework->output_classes = output_classes;
+      }
+      sub_oracle->weak_confidence = weak_confidence;
+      multi_framework->add(sub_framework, sub_oracle, sub_naive);
+    }
+    oracle = nullptr;
+    output_classes = 0;
+  }else if(replay_file != ""){
+    PLOG_INFO << "Replaying oracle responses from " << replay_file;
+    boost::icl::interval_set<pointer> ranges;
+    std::vector<trace_record> records;
+    auto header = read_trace(replay_file, ranges, records);
+    if(header.addr_kind == TRACE_ADDR_RANGE){
+      addr = new SimAddr(header.maxbits, get_ranges_dram_ctx(ranges));
+    }else{
+      addr = new VirtAddr(header.maxbits, false);
+    }
+    oracle = new ReplayOracle(10,tresh_oracle,header,records);
+    naive = header.naive;
+    seed = header.seed;
+  }else{
+    switch (set)
+    {
+    case 0:
+      PLOG_INFO << "Measuring cache slices with performance counters";
+      oracle = new SliceOracle(10,tresh_oracle,is_xeon);
+      addr = new PhysAddr(phys_window_bits, phys_windows);
+      break;
+    case 1: 
+      PLOG_INFO << "Measuring cache slices with timing";
+      addr = new PhysAddr(phys_window_bits, phys_windows);
+      oracle = new SliceTimingOracle(10,tresh_oracle,addr);
+      break;
+    case 2:
+      PLOG_INFO << "Measuring utag hash function";
+      try{
+        addr = new VirtAddr(virt_bits, true, parse_virt_backing(virt_backing_name), !virt_lazy, virt_alias_bits);
+      }catch (const std::exception& e){
+        PLOG_FATAL << e.what();
+        exit(1);
+      }
+      oracle = new UtagOracle(10,tresh_oracle,addr);
+      naive = true;
+      break;
+    case 3: 
+      PLOG_INFO << "Measuring DRAM addressing function";
+      addr = new PhysAddr(phys_window_bits, phys_windows);
+      oracle = new DramaOracle(10,tresh_oracle,addr);
+      naive = true;
+      break;
+    case 4:
+    case 5: {
+      if(sim_function_file == ""){
+        PLOG_FATAL << "Simulated frameworks require a hash function given with --sim-function";
+        exit(1);
+      }
+      PLOG_INFO << "Measuring simulated hash function from " << sim_function_file;
+      if(sim_seed == 0){
+        sim_seed = std::random_device()();
+      }
+      addr = new SimAddr(sim_bits, parse_ranges(sim_holes));
+      oracle = new SimOracle(10,tresh_oracle,HashFunction(sim_function_file),noise,sim_seed);
+      naive = set == 5;
+      break;
+    }
+    default:
+      PLOG_ERROR << "Invalid oracle selected current choices 0-5";
+      exit(1);
+    }
+  }
+
+  // Oracles may select addresses while they are built, so the address
+  // selection of the framework is seeded afterwards to be reproducible
+  if(seed == 0){
+    seed = ((uint64_t)std::random_device()() << 32) | std::random_device()();
+  }
+  addr->seed(seed);
+  PLOG_INFO << "Address selection seed 0x" << std::hex << seed << std::dec;
+  if(record_file != ""){
+    oracle = new RecordingOracle(oracle,addr,record_file,naive);
+  }
+
+  // Classes of a linear function form a group under address bit flips, with
+  // binary codes along that group the bitwise framework can dump them
+  bool relabelled = false;
+  if(naive && relabel && !multi_framework){
+    PLOG_INFO << "Relabelling the classes of the indirect oracle";
+    try{
+      oracle = new LabelledOracle(oracle, addr);
+      relabelled = true;
+      naive = false;
+    }catch (const OracleMiss& e){
+      PLOG_FATAL << "Oracle call not covered by " << replay_file << ": " << e.what();
+      exit(1);
+    }catch (const std::exception& e){
+      PLOG_WARNING << "Dumping all output bits at once, the classes cannot be relabelled: " << e.what();
+    }
+  }
+
+  // Class labels of indirect oracles have no output bits to compare a solution with, the codes
+  // of relabelled classes are not the output bits of the hash either
+  if((naive || relabelled) && verify_function.output_bit >= 0){
+    PLOG_FATAL << verify_file << " describes output bit " << verify_function.output_bit
+               << ", only oracles that return the hash have output bits";
     exit(1);
   }
 
+  // The only dispatch on the address pool and oracle type, the frameworks
+  // call them directly from here on
+  if(naive || relabelled){
+    output_classes = oracle->output_classes;
+  }
+  if(multi_framework){
+    framework = multi_framework;
+  }else if(record_file != "" || replay_file != "" || relabelled){
+    framework = make_framework(naive,core,addr,oracle);
+  }else{
+    switch (set)
+    {
+    case 0:
+      framework = new BitwiseFramework<PhysAddr,SliceOracle>(core,static_cast<PhysAddr*>(addr),static_cast<SliceOracle*>(oracle));
+      break;
+    case 1:
+      framework = new BitwiseFramework<PhysAddr,SliceTimingOracle>(core,static_cast<PhysAddr*>(addr),static_cast<SliceTimingOracle*>(oracle));
+      break;
+    case 2:
+      framework = new NaiveFramework<VirtAddr,UtagOracle>(core,static_cast<VirtAddr*>(addr),static_cast<UtagOracle*>(oracle));
+      break;
+    case 3:
+      framework = new NaiveFramework<PhysAddr,DramaOracle>(core,static_cast<PhysAddr*>(addr),static_cast<DramaOracle*>(oracle));
+      break;
+    default:
+      framework = make_framework(naive,core,static_cast<SimAddr*>(addr),static_cast<SimOracle*>(oracle));
+    }
+  }
+
   framework->bit_limit_hi = bit_limit_hi;
   framework->bit_limit_lo = bit_limit_lo;
-
-  // Set output classes if given else infer
-  if(output_classes == 0){
-    PLOG_INFO << "Determening output classes";
-    framework->determine_output_classes();
-  }else{
-    oracle->output_classes = output_classes;
-    framework->output_classes = output_classes;
+  framework->two_pass = two_pass;
+  framework->tile = tile;
+  framework->shard = shard_selected;
+  framework->output_dir = output_dir;
+  framework->first_pass_calls = first_pass_calls;
+  framework->pla = pla_spec{pla, pla_binary, pla_min_margin};
+  framework->labelled = relabelled;
+  if(oracle){
+    oracle->weak_confidence = weak_confidence;
+  }
+  if(numa){
+    auto phys = dynamic_cast<PhysAddr*>(addr);
+    if(phys){
+      framework->numa = std::make_shared<NumaScheduler>(phys->get_numa_nodes(), core, housekeeping_core);
+      phys->keep_nodes(phys->get_numa_nodes());
+    }else{
+      PLOG_WARNING << "--numa only applies to physical addresses, ignoring it";
+    }
   }
-  PLOG_INFO << "Output class count: " << framework->output_classes;
+  auto numa_scheduler = framework->numa;
 
-  if(input_bits_file == ""){
-    PLOG_INFO << "Measuring relevant input bits";
-    framework->get_input_space_bits();
-  }else{
-    PLOG_INFO << "Reading relevant input bits from " << input_bits_file;
-    std::ifstream file(input_bits_file.c_str());
-    typedef boost::tokenizer<boost::escaped_list_separator<char> > Tokenizer;
-    std::vector<std::string> vec;
-    std::string line;
+  // A replay that leaves the recorded trace cannot be continued
+  bool verified = true;
+  try{
+    // Set output classes if given else infer, the multi framework only infers missing ones
+    bool db_classes = output_classes == 0 && db_hit && db_entry.output_classes != 0;
+    if(db_classes){
+      output_classes = db_entry.output_classes;
+    }
+    if(output_classes == 0){
+      PLOG_INFO << "Determening output classes";
+      Metrics::set_phase(PHASE_OUTPUT_CLASSES);
+      addr->seed(seed + PHASE_OUTPUT_CLASSES);
+      framework->determine_output_classes();
+    }else{
+      oracle->output_classes = output_classes;
+      framework->output_classes = output_classes;
+    }
+    if(!multi_framework){
+      PLOG_INFO << "Output class count: " << framework->output_classes;
+    }
+    // Shards measured with different class counts cannot be merged, record it for unscatter-merge
+    if(shard_selected.shards > 1){
+      shard_selected.classes = framework->output_classes;
+      write_shard_file(output_dir, shard_selected);
+    }
 
-    while (getline(file,line))
-    {
-        Tokenizer tok(line);
-        vec.assign(tok.begin(),tok.end());
-        std::vector<uint64_t> bits;
-        for(auto elem : vec){
-          bits.push_back(std::stoi(elem));
+    bool recover = true;
+    if(verify_file != "" || db_hit){
+      PLOG_INFO << "Measuring " << verify_samples << " random addresses";
+      Metrics::set_phase(PHASE_VERIFY);
+      addr->seed(seed + PHASE_VERIFY);
+      verified = framework->verify(verify_function, verify_samples);
+      recover = false;
+      if(db_hit && !verified){
+        PLOG_WARNING << db_entry.path << " does not hold on this machine, recovering the function";
+        verified = true;
+        recover = true;
+        if(db_classes){
+          Metrics::set_phase(PHASE_OUTPUT_CLASSES);
+          addr->seed(seed + PHASE_OUTPUT_CLASSES);
+          framework->determine_output_classes();
+          PLOG_INFO << "Output class count: " << framework->output_classes;
         }
-        framework->input_space_bits.push_back(bits);
-        framework->input_space_linear.push_back(false);
+      }else if(db_hit){
+        FunctionDb::write(output_dir + "/" FUNCTION_DB_FILE, db_key, verify_function, framework->output_classes);
+        PLOG_INFO << "Function of " << db_key << " written to " << output_dir << "/" FUNCTION_DB_FILE;
+      }else if(db && verified && verify_function.output_bit >= 0){
+        PLOG_WARNING << verify_file << " only describes output bit " << verify_function.output_bit
+                     << ", the function database stores whole functions";
+      }else if(db && verified){
+        db->store(db_key, verify_function, framework->output_classes);
+        PLOG_INFO << "Stored " << verify_file << " in the function database as " << db_key;
+      }
     }
-  }
 
-  PLOG_INFO << "Relevant input bits for h[x]:\n" <<framework->input_space_bits;
-  PLOG_INFO << "Linear bits of h:\n" << framework->input_space_linear;
-  if(dry_run){
-    PLOG_INFO << "Performing dry run";
-    framework->dry_run();
-  }else{
-    PLOG_INFO << "Dumping truth table";
-    framework->dump_truth_table();
+    if(!recover){
+      // Random addresses need neither the relevant bits nor a dump
+    }else if(input_bits_file == ""){
+      PLOG_INFO << "Measuring relevant input bits";
+      Metrics::set_phase(PHASE_INPUT_SPACE);
+      addr->seed(seed + PHASE_INPUT_SPACE);
+      framework->get_input_space_bits();
+    }else{
+      PLOG_INFO << "Reading relevant input bits from " << input_bits_file;
+      std::ifstream file(input_bits_file.c_str());
+      typedef boost::tokenizer<boost::escaped_list_separator<char> > Tokenizer;
+      std::vector<std::string> vec;
+      std::string line;
+
+      while (getline(file,line))
+      {
+          Tokenizer tok(line);
+          vec.assign(tok.begin(),tok.end());
+          std::vector<uint64_t> bits;
+          for(auto elem : vec){
+            bits.push_back(std::stoi(elem));
+          }
+          framework->input_space_bits.push_back(bits);
+          framework->input_space_linear.push_back(false);
+      }
+
+      // Keep the output directory self contained for the tools, bits.csv holds the bits within the limits
+      std::vector<std::vector<uint64_t>> bits_within_limits;
+      for(auto& bits : framework->input_space_bits){
+        bits_within_limits.emplace_back();
+        std::copy_if(bits.begin(), bits.end(), std::back_inserter(bits_within_limits.back()),
+                     [&](uint64_t b){ return b < (uint64_t)bit_limit_hi && b > (uint64_t)bit_limit_lo; });
+      }
+      write_bits_file(output_dir + "/bits.csv", bits_within_limits);
+    }
+
+    if(!multi_framework && recover){
+      PLOG_INFO << "Relevant input bits for h[x]:\n" <<framework->input_space_bits;
+      PLOG_INFO << "Linear bits of h:\n" << framework->input_space_linear;
+    }
+    if(!recover){
+      // Verified above
+    }else if(dry_run){
+      PLOG_INFO << "Performing dry run";
+      Metrics::set_phase(PHASE_DRY_RUN);
+      addr->seed(seed + PHASE_DRY_RUN);
+      framework->dry_run();
+    }else{
+      PLOG_INFO << "Dumping truth table";
+      Metrics::set_phase(PHASE_DUMP);
+      addr->seed(seed + PHASE_DUMP);
+      framework->dump_truth_table();
+    }
+  }catch (const OracleMiss& e){
+    PLOG_FATAL << "Oracle call not covered by " << replay_file << ": " << e.what();
+    exit(1);
   }
+  // Finish the trace before reporting
+  delete framework;
+  if(numa_scheduler){
+    numa_scheduler->report(output_dir);
+  }
+  Metrics::set_phase(PHASE_SETUP);
+  progress.reset();
+  exporter.reset();
+  Metrics::write_json(output_dir + "/metrics.json");
+  PLOG_INFO << "Oracle calls " << Metrics::total(COUNTER_ORACLE_CALLS) << ", remeasures " << Metrics::total(COUNTER_RETRIES)
+            << ", exceeded retries " << Metrics::total(COUNTER_EXCEPTIONS) << ", see " << output_dir << "/metrics.json";
   
   // Log execution time
   auto stop = std::chrono::high_resolution_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
   PLOG_INFO << "Overall runtime " <<  duration.count() << "s";
-
+  if(Housekeeping::write_failures()){
+    PLOG_ERROR << Housekeeping::write_failures() << " output files could not be written completely";
+    return 1;
+  }
+  return verified ? 0 : 1;
 }
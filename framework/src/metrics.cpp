@@ -0,0 +1,299 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <plog/Log.h>
+
+#include "../include/metrics.hpp"
+#include "../include/housekeeping.hpp"
+
+static const char* phase_names[PHASE_COUNT] = {"setup", "output_classes", "input_space", "dump", "dry_run", "verify"};
+static const char* counter_names[COUNTER_COUNT] = {"oracle_calls", "decisions", "retries", "exceptions", "entries",
+                                                   "unmappable", "flagged", "addr_ns", "oracle_ns", "io_ns", "io_stalls",
+                                                   "recalibrations", "weak_accepts", "unlabelled", "wall_ns"};
+static const char* histogram_names[HIST_COUNT] = {"oracle_ns", "votes"};
+
+static std::mutex registry_lock;
+static std::vector<metrics_shard*> registry;
+
+static thread_local metrics_shard* local_shard = nullptr;
+static thread_local metrics_phase local_phase = PHASE_SETUP;
+static thread_local size_t local_bit = METRICS_MAX_BITS;
+static thread_local std::chrono::steady_clock::time_point local_phase_start = std::chrono::steady_clock::now();
+
+/*
+ * Returns the shard of the calling thread, shards are never freed so that
+ * metrics of finished threads are still exported
+ */
+metrics_shard* Metrics::shard() {
+  if (!local_shard) {
+    local_shard = new metrics_shard();
+    std::lock_guard<std::mutex> guard(registry_lock);
+    registry.push_back(local_shard);
+  }
+  return local_shard;
+}
+
+/*
+ * Switches the phase of the calling thread and accounts the wall time of the
+ * previous one
+ */
+void Metrics::set_phase(metrics_phase phase) {
+  auto now = std::chrono::steady_clock::now();
+  auto& wall = shard()->counters[local_phase][METRICS_MAX_BITS][COUNTER_WALL_NS];
+  wall.store(wall.load(std::memory_order_relaxed) +
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(now - local_phase_start).count(),
+             std::memory_order_relaxed);
+  local_phase_start = now;
+  local_phase = phase;
+  local_bit = METRICS_MAX_BITS;
+}
+
+/*
+ * Selects the output bit further metrics are accounted to, -1 for none
+ */
+void Metrics::set_bit(int bit) {
+  local_bit = (bit < 0 || bit >= METRICS_MAX_BITS) ? METRICS_MAX_BITS : bit;
+}
+
+metrics_slot Metrics::slot() {
+  auto s = shard();
+  return metrics_slot{s->counters[local_phase][local_bit], s->histograms[local_phase]};
+}
+
+void Metrics::add(metrics_counter counter, uint64_t value) {
+  auto& c = shard()->counters[local_phase][local_bit][counter];
+  c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Metrics::record(metrics_histogram histogram, uint64_t value) {
+  auto& h = shard()->histograms[local_phase][histogram][bucket(value)];
+  h.store(h.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*
+ * Log linear bucket of a value, exact below 16 and with 16 sub buckets per
+ * power of two above
+ */
+size_t Metrics::bucket(uint64_t value) {
+  if (value < (1 << METRICS_HIST_SUB_BITS)) {
+    return value;
+  }
+  size_t exponent = 63 - __builtin_clzll(value);
+  size_t sub = (value >> (exponent - METRICS_HIST_SUB_BITS)) & ((1 << METRICS_HIST_SUB_BITS) - 1);
+  return ((exponent - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) + sub;
+}
+
+/*
+ * Lowest value that falls into a bucket
+ */
+uint64_t Metrics::bucket_value(size_t bucket) {
+  if (bucket < (1 << METRICS_HIST_SUB_BITS)) {
+    return bucket;
+  }
+  size_t exponent = (bucket >> METRICS_HIST_SUB_BITS) + METRICS_HIST_SUB_BITS - 1;
+  uint64_t sub = bucket & ((1 << METRICS_HIST_SUB_BITS) - 1);
+  return ((1ULL << METRICS_HIST_SUB_BITS) + sub) << (exponent - METRICS_HIST_SUB_BITS);
+}
+
+std::unique_ptr<metrics_totals> Metrics::sum_shards() {
+  std::unique_ptr<metrics_totals> totals(new metrics_totals());
+  auto& counters = totals->counters;
+  auto& histograms = totals->histograms;
+  std::lock_guard<std::mutex> guard(registry_lock);
+  for (auto s : registry) {
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+      for (size_t b = 0; b < METRICS_BIT_SLOTS; b++) {
+        for (size_t c = 0; c < COUNTER_COUNT; c++) {
+          counters[p][b][c] += s->counters[p][b][c].load(std::memory_order_relaxed);
+        }
+      }
+      for (size_t h = 0; h < HIST_COUNT; h++) {
+        for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+          histograms[p][h][i] += s->histograms[p][h][i].load(std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+  return totals;
+}
+
+/*
+ * Sum of a counter over all threads, phases and bits
+ */
+uint64_t Metrics::total(metrics_counter counter) {
+  auto totals = sum_shards();
+  uint64_t sum = 0;
+  for (size_t p = 0; p < PHASE_COUNT; p++) {
+    for (size_t b = 0; b < METRICS_BIT_SLOTS; b++) {
+      sum += totals->counters[p][b][counter];
+    }
+  }
+  return sum;
+}
+
+/*
+ * Writes count, mean, percentiles and max of a histogram as json object
+ */
+static void write_histogram_json(std::ofstream& out, uint64_t* buckets) {
+  uint64_t count = 0;
+  double sum = 0;
+  for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+    count += buckets[i];
+    sum += (double)buckets[i] * Metrics::bucket_value(i);
+  }
+  out << "{\"count\": " << count << ", \"mean\": " << (count ? sum / count : 0);
+  const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+  const char* quantile_names[] = {"p50", "p90", "p99", "max"};
+  for (size_t q = 0; q < 4; q++) {
+    uint64_t seen = 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS && count; i++) {
+      seen += buckets[i];
+      if (buckets[i] && seen >= quantiles[q] * count) {
+        value = Metrics::bucket_value(i);
+        break;
+      }
+    }
+    out << ", \"" << quantile_names[q] << "\": " << value;
+  }
+  out << "}";
+}
+
+static void write_counters_json(std::ofstream& out, uint64_t* counters) {
+  out << "{";
+  for (size_t c = 0; c < COUNTER_COUNT; c++) {
+    out << (c ? ", " : "") << "\"" << counter_names[c] << "\": " << counters[c];
+  }
+  out << "}";
+}
+
+/*
+ * Exports all metrics aggregated over threads, per phase and per output bit
+ */
+void Metrics::write_json(std::string path) {
+  auto totals = sum_shards();
+  auto& counters = totals->counters;
+  auto& histograms = totals->histograms;
+
+  std::ofstream out(path);
+  out << "{\n  \"phases\": {";
+  for (size_t p = 0; p < PHASE_COUNT; p++) {
+    uint64_t total[COUNTER_COUNT] = {0};
+    for (size_t b = 0; b < METRICS_BIT_SLOTS; b++) {
+      for (size_t c = 0; c < COUNTER_COUNT; c++) {
+        total[c] += counters[p][b][c];
+      }
+    }
+    out << (p ? "," : "") << "\n    \"" << phase_names[p] << "\": {\n      \"total\": ";
+    write_counters_json(out, total);
+    out << ",\n      \"histograms\": {";
+    for (size_t h = 0; h < HIST_COUNT; h++) {
+      out << (h ? ", " : "") << "\"" << histogram_names[h] << "\": ";
+      write_histogram_json(out, histograms[p][h]);
+    }
+    out << "},\n      \"bits\": {";
+    bool first = true;
+    for (size_t b = 0; b < METRICS_MAX_BITS; b++) {
+      bool used = false;
+      for (size_t c = 0; c < COUNTER_COUNT; c++) {
+        used |= counters[p][b][c] != 0;
+      }
+      if (!used) {
+        continue;
+      }
+      out << (first ? "" : ",") << "\n        \"" << b << "\": ";
+      write_counters_json(out, counters[p][b]);
+      first = false;
+    }
+    out << (first ? "" : "\n      ") << "}\n    }";
+  }
+  out << "\n  }\n}\n";
+}
+
+/*
+ * Exports the metrics in the prometheus textfile format, the file is replaced
+ * atomically so readers never see a partial file
+ */
+void Metrics::write_textfile(std::string path) {
+  auto totals = sum_shards();
+  auto& counters = totals->counters;
+  auto& histograms = totals->histograms;
+
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp);
+    for (size_t c = 0; c < COUNTER_COUNT; c++) {
+      out << "# TYPE unscatter_" << counter_names[c] << " counter\n";
+      for (size_t p = 0; p < PHASE_COUNT; p++) {
+        for (size_t b = 0; b < METRICS_BIT_SLOTS; b++) {
+          if (!counters[p][b][c]) {
+            continue;
+          }
+          out << "unscatter_" << counter_names[c] << "{phase=\"" << phase_names[p] << "\"";
+          if (b != METRICS_MAX_BITS) {
+            out << ",bit=\"" << b << "\"";
+          }
+          out << "} " << counters[p][b][c] << "\n";
+        }
+      }
+    }
+    for (size_t h = 0; h < HIST_COUNT; h++) {
+      out << "# TYPE unscatter_" << histogram_names[h] << " histogram\n";
+      for (size_t p = 0; p < PHASE_COUNT; p++) {
+        uint64_t cumulative = 0;
+        double sum = 0;
+        for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+          if (!histograms[p][h][i]) {
+            continue;
+          }
+          cumulative += histograms[p][h][i];
+          sum += (double)histograms[p][h][i] * bucket_value(i);
+          out << "unscatter_" << histogram_names[h] << "_bucket{phase=\"" << phase_names[p] << "\",le=\""
+              << bucket_value(i + 1) - 1 << "\"} " << cumulative << "\n";
+        }
+        if (!cumulative) {
+          continue;
+        }
+        out << "unscatter_" << histogram_names[h] << "_bucket{phase=\"" << phase_names[p] << "\",le=\"+Inf\"} "
+            << cumulative << "\n";
+        out << "unscatter_" << histogram_names[h] << "_sum{phase=\"" << phase_names[p] << "\"} " << sum << "\n";
+        out << "unscatter_" << histogram_names[h] << "_count{phase=\"" << phase_names[p] << "\"} " << cumulative
+            << "\n";
+      }
+    }
+  }
+  if (rename(tmp.c_str(), path.c_str())) {
+    PLOG_WARNING << "Could not write metrics to " << path;
+  }
+}
+
+MetricsExporter::MetricsExporter(std::string path, unsigned interval) {
+  this->path = path;
+  this->interval = interval;
+  this->stopped = false;
+  this->thread = std::thread(&MetricsExporter::run, this);
+}
+
+/*
+ * Stops the exporter and writes the final state
+ */
+MetricsExporter::~MetricsExporter() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopped = true;
+  }
+  this->wakeup.notify_all();
+  this->thread.join();
+  Metrics::write_textfile(this->path);
+}
+
+void MetricsExporter::run() {
+  Housekeeping::pin();
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (!this->stopped) {
+    if (!this->wakeup.wait_for(guard, std::chrono::seconds(this->interval), [this] { return this->stopped; })) {
+      Metrics::write_textfile(this->path);
+    }
+  }
+}
@@ -0,0 +1,266 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <plog/Log.h>
+
+#include "../include/addr.hpp"
+#include "../include/utils.hpp"
+#include "../include/framework.hpp"
+#include "../include/oracle.hpp"
+#include "../include/metrics.hpp"
+#include "../include/progress.hpp"
+#include "../include/housekeeping.hpp"
+
+/*
+ * One truth table of the combined walk
+ */
+typedef struct multi_table {
+  size_t framework; // index of the framework the table belongs to
+  int64_t bit; // output bit of the table, -1 for all bits of a naive oracle
+  uint64_t mask; // relevant bits of the table within the bit limits
+  std::unique_ptr<DumpWriter> dumpfile;
+} multi_table;
+
+MultiFramework::MultiFramework(IAddr* addr) {
+  this->addr = addr;
+}
+
+MultiFramework::~MultiFramework() {
+  for (auto framework : this->frameworks) {
+    delete framework;
+  }
+  delete this->addr;
+}
+
+/*
+ * Adds a framework that measures on the shared address pool, the multi
+ * framework takes ownership of it
+ */
+void MultiFramework::add(Framework* framework, Oracle* oracle, bool naive) {
+  framework->owns_addr = false;
+  this->frameworks.push_back(framework);
+  this->oracles.push_back(oracle);
+  this->naive.push_back(naive);
+}
+
+/*
+ * Hands the settings of the multi framework to the frameworks it runs
+ */
+void MultiFramework::propagate_settings() {
+  for (auto framework : this->frameworks) {
+    framework->bit_limit_hi = this->bit_limit_hi;
+    framework->bit_limit_lo = this->bit_limit_lo;
+    framework->two_pass = this->two_pass;
+    framework->first_pass_calls = this->first_pass_calls;
+    framework->numa = this->numa;
+    framework->pla = this->pla;
+  }
+}
+
+/*
+ * Determines the output classes of all frameworks that do not know them yet
+ */
+void MultiFramework::determine_output_classes() {
+  this->propagate_settings();
+  for (size_t f = 0; f < this->frameworks.size(); f++) {
+    if (this->frameworks[f]->output_classes == 0) {
+      this->frameworks[f]->determine_output_classes();
+    }
+    PLOG_INFO << this->frameworks[f]->output_dir << ": output class count " << this->frameworks[f]->output_classes;
+  }
+}
+
+/*
+ * Relevant bits differ between the functions, so every framework searches its
+ * own
+ */
+void MultiFramework::get_input_space_bits() {
+  this->propagate_settings();
+  for (auto framework : this->frameworks) {
+    PLOG_INFO << "Computing relevant input space of " << framework->output_dir;
+    framework->get_input_space_bits();
+    PLOG_INFO << "Relevant input bits for h[x]:\n" << framework->input_space_bits;
+    PLOG_INFO << "Linear bits of h:\n" << framework->input_space_linear;
+  }
+}
+
+/*
+ * Measures an address robustly, retrying until the oracle reaches a decision
+ */
+uint64_t MultiFramework::measure_robust(Oracle* oracle, pointer mapped_addr, pointer select_addr) {
+  while (true) {
+    try {
+      // This can error if the maximum retry  is exceeded
+      return oracle->oracle_robust(mapped_addr, select_addr, 10);
+    } catch (const OracleMiss&) {
+      throw;
+    } catch (...) {
+      PLOG_DEBUG << "REMEASURE triggerd while dumping";
+    }
+  }
+}
+
+/*
+ * Dumps the truth tables of all frameworks in one walk over the union of their
+ * entries. Every distinct set of relevant bits is walked in turn, skipping the
+ * combinations an earlier set already covered, so every address is visited
+ * once and every oracle measures it at most once no matter how many of its
+ * tables contain it.
+ */
+void MultiFramework::dump_truth_table() {
+  this->propagate_settings();
+  if (this->two_pass) {
+    PLOG_WARNING << "Two pass dumps are not supported for several oracles, dumping with robust measurements only";
+  }
+  if (this->tile) {
+    PLOG_WARNING << "Tiled dumps are not supported for several oracles, bits outside the limits stay zero";
+  }
+
+  std::vector<multi_table> tables;
+  std::vector<uint64_t> all_bits; // relevant bits of all tables, bits outside the limits stay zero
+  std::vector<uint64_t> masks; // distinct relevant bits of the tables within the limits
+  for (size_t f = 0; f < this->frameworks.size(); f++) {
+    auto framework = this->frameworks[f];
+    size_t table_count = this->naive[f] ? std::min<size_t>(1, framework->input_space_bits.size())
+                                        : framework->input_space_bits.size();
+    for (size_t bit_idx = 0; bit_idx < table_count; bit_idx++) {
+      if (!this->naive[f] && framework->input_space_linear[bit_idx]) {
+        PLOG_INFO << framework->output_dir << ": h[" << bit_idx << "] is linear, skipping dump";
+        continue;
+      }
+      uint64_t mask = 0;
+      std::vector<uint64_t> table_bits;
+      for (auto b : framework->input_space_bits[bit_idx]) {
+        if (std::find(all_bits.begin(), all_bits.end(), b) == all_bits.end()) {
+          all_bits.push_back(b);
+        }
+        if (b < this->bit_limit_hi && b > this->bit_limit_lo) {
+          mask |= 1ULL << b;
+          table_bits.push_back(b);
+        }
+      }
+      char buff[100];
+      snprintf(buff, sizeof(buff), "/bit_%ld.csv", bit_idx);
+      std::string path = framework->output_dir + (this->naive[f] ? std::string("/allbits.csv") : std::string(buff));
+      int64_t bit = this->naive[f] ? -1 : (int64_t)bit_idx;
+      tables.push_back(multi_table{f, bit, mask,
+                                   std::unique_ptr<DumpWriter>(new DumpWriter(path, this->pla, table_bits, bit,
+                                                                              framework->output_classes))});
+      if (std::find(masks.begin(), masks.end(), mask) == masks.end()) {
+        masks.push_back(mask);
+      }
+    }
+  }
+  if (tables.empty()) {
+    PLOG_WARNING << "No truth table to dump";
+    return;
+  }
+  std::sort(all_bits.begin(), all_bits.end());
+
+  uint64_t table_entries = 0;
+  for (auto& table : tables) {
+    table_entries += 1ULL << __builtin_popcountll(table.mask);
+  }
+  PLOG_INFO << "Dumping " << tables.size() << " tables of " << this->frameworks.size() << " oracles with "
+            << masks.size() << " distinct sets of relevant bits, " << table_entries << " entries";
+  Progress::begin_run(table_entries);
+  Progress::begin_table(-1, table_entries);
+
+  std::vector<bool> needed(this->frameworks.size());
+  std::vector<uint64_t> oracle_out(this->frameworks.size());
+  uint64_t visited = 0;
+  for (size_t m = 0; m < masks.size(); m++) {
+    // Combinations of the set that no earlier set covers, counted from the
+    // current one in submask order. Returns false after the last one.
+    auto next_uncovered = [&](uint64_t& c, uint64_t& steps) {
+      steps = 0;
+      do {
+        c = (c - masks[m]) & masks[m];
+        steps++;
+        bool covered = false;
+        for (size_t earlier = 0; earlier < m && !covered; earlier++) {
+          covered = (c & ~masks[earlier]) == 0;
+        }
+        if (!covered) {
+          return c != 0;
+        }
+      } while (c != 0);
+      return false;
+    };
+    uint64_t combination = 0, steps = 0;
+    bool more = m == 0 || next_uncovered(combination, steps);
+    if (!more) {
+      continue;
+    }
+    // The iterator spans all relevant bits so that addresses are only
+    // adjusted in bits no table depends on, it walks the bits of the set
+    uint64_t lowest = masks[m] & -masks[m];
+    this->addr->init_bitmask_iterator(all_bits, combination, masks[m]);
+    while (more) {
+      uint64_t next = combination;
+      more = next_uncovered(next, steps);
+      std::pair<pointer, bool> addr_tuple;
+      {
+        MetricsTimer timer(COUNTER_ADDR_NS);
+        addr_tuple = this->addr->advance_bitmask_iterator(steps * lowest);
+      }
+      pointer select_addr = addr_tuple.first;
+      bool can_map = addr_tuple.second;
+      std::fill(needed.begin(), needed.end(), false);
+      for (auto& table : tables) {
+        if ((combination & ~table.mask) == 0) {
+          needed[table.framework] = true;
+        }
+      }
+
+      if (can_map) {
+        auto mapped_addr = this->addr->map_addr(select_addr);
+        if (this->numa) {
+          this->numa->schedule(select_addr);
+        }
+        for (size_t f = 0; f < this->frameworks.size(); f++) {
+          if (needed[f]) {
+            oracle_out[f] = measure_robust(this->oracles[f], mapped_addr, select_addr);
+          }
+        }
+      }
+      visited++;
+
+      MetricsTimer timer(COUNTER_IO_NS);
+      for (auto& table : tables) {
+        if ((combination & ~table.mask) != 0) {
+          continue;
+        }
+        uint64_t value = 0;
+        uint32_t margin = 0;
+        if (can_map) {
+          auto oracle = this->oracles[table.framework];
+          value = table.bit < 0 ? oracle_out[table.framework] : (oracle_out[table.framework] >> table.bit) & 0x1;
+          margin = table.bit < 0 ? oracle->margin() : oracle->bit_margin(table.bit);
+        }
+        table.dumpfile->push(dump_record{select_addr, value, can_map, margin});
+        Metrics::add(COUNTER_ENTRIES);
+        if (!can_map) {
+          Metrics::add(COUNTER_UNMAPPABLE);
+        }
+        Progress::advance();
+      }
+      combination = next;
+    }
+  }
+  PLOG_INFO << "Measured " << visited << " addresses for " << table_entries << " entries";
+}
+
+/*
+ * Performs a dry run of every framework
+ */
+void MultiFramework::dry_run() {
+  this->propagate_settings();
+  for (auto framework : this->frameworks) {
+    PLOG_INFO << "Dry run of " << framework->output_dir;
+    framework->dry_run();
+  }
+}
@@ -28,6 +28,10 @@
 #include "../include/utils.hpp"
 #include "../include/framework.hpp"
 #include "../include/oracle.hpp"
+#include "../include/metrics.hpp"
+#include "../include/progress.hpp"
+#include "../include/housekeeping.hpp"
+#include "../include/verify.hpp"
 
 #define THRESHOLD_FIXPOINT_ITERATION 500
 #define ITERATIONS_INPUT_SPACE_MEASURE 10
@@ -41,14 +45,19 @@
  * If concrete output classes are known beforehand this part can be skipped.
  * To skip this step just overwrite the output classes of the framework direcly.
  */
-void NaiveFramework::determine_output_classes() {
+template <typename AddrT, typename OracleT>
+void NaiveFramework<AddrT, OracleT>::determine_output_classes() {
   std::set<uint64_t> oracle_outputs;
   uint64_t unchanged_iterations = 0;
   while (unchanged_iterations < THRESHOLD_FIXPOINT_ITERATION) {
     auto size_before = oracle_outputs.size();
-    auto random_addr = this->addr->get_random_addr();
-    auto mapped_addr = this->addr->map_addr(random_addr);
-    oracle_outputs.insert(this->oracle->oracle(mapped_addr));
+    pointer mapped_addr;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      auto random_addr = this->addr->get_random_addr();
+      mapped_addr = this->addr->map_addr(random_addr);
+    }
+    oracle_outputs.insert(this->oracle->template timed_oracle<OracleT>(mapped_addr));
     auto size_after = oracle_outputs.size();
     if (size_before == size_after) {
       unchanged_iterations++;
@@ -65,7 +74,8 @@ void NaiveFramework::determine_output_classes() {
  * The precision of this measurement can be increased by increasing the
  * threshold parameter
  */
-void NaiveFramework::get_input_space_bits() {
+template <typename AddrT, typename OracleT>
+void NaiveFramework<AddrT, OracleT>::get_input_space_bits() {
     std::vector<uint64_t> out_class_bits;
     PLOG_INFO << "Computing relevant input space";
     PLOG_DEBUG << this->addr->maxbits;
@@ -80,14 +90,20 @@ void NaiveFramework::get_input_space_bits() {
       for (size_t iteration = 0; iteration < ITERATIONS_INPUT_SPACE_MEASURE;
            iteration++) {
         // Get a pair of addresses where the bit index addr_bit is flipped between the two addresses
-        auto pair = this->addr->get_flip_pair(addr_bit);
-        auto addr_1 = pair.first;
-        auto addr_2 = pair.second;
-        auto addr_1_mapped = this->addr->map_addr(addr_1);
-        auto addr_2_mapped = this->addr->map_addr(addr_2);
+        pointer addr_1, addr_2, addr_1_mapped, addr_2_mapped;
+        {
+          MetricsTimer timer(COUNTER_ADDR_NS);
+          auto pair = this->addr->get_flip_pair(addr_bit);
+          addr_1 = pair.first;
+          addr_2 = pair.second;
+          addr_1_mapped = this->addr->map_addr(addr_1);
+          addr_2_mapped = this->addr->map_addr(addr_2);
+        }
+        // Measuring one must not unmap the other
+        AddrPin pin_1(this->addr, addr_1), pin_2(this->addr, addr_2);
 
-        auto first_measure = this->oracle->oracle_robust(addr_1_mapped, addr_1, MAX_RETRIES_ORACLE);
-        auto second_measure = this->oracle->oracle_robust(addr_2_mapped, addr_2, MAX_RETRIES_ORACLE);
+        auto first_measure = this->oracle->template oracle_robust<OracleT>(addr_1_mapped, addr_1, MAX_RETRIES_ORACLE);
+        auto second_measure = this->oracle->template oracle_robust<OracleT>(addr_2_mapped, addr_2, MAX_RETRIES_ORACLE);
 
         if(first_measure != second_measure){
           addr_bit_relevant = true;
@@ -109,8 +125,9 @@ void NaiveFramework::get_input_space_bits() {
     }
 
     // Dump relevant input space bits
+    MetricsTimer timer(COUNTER_IO_NS);
     std::ofstream bitfile;
-    bitfile.open("measurements/bits.csv");
+    bitfile.open(this->output_dir + "/bits.csv");
 
     for(auto input_space : this->input_space_bits){
       if(input_space_bits.size() != 0){
@@ -129,17 +146,60 @@ void NaiveFramework::get_input_space_bits() {
 }
 
 /*
-* Dumps truth tables for all relevant bits
+* Measures an address robustly, retrying until the oracle reaches a decision
 */
-void NaiveFramework::dump_truth_table(){
+template <typename AddrT, typename OracleT>
+uint64_t NaiveFramework<AddrT, OracleT>::measure_robust(pointer mapped_addr, pointer select_addr){
+  if(this->numa){
+    this->numa->schedule(select_addr);
+  }
+  while (true)
+  {
+    try{
+      // This can error if the maximum retry  is exceeded
+      return this->oracle->template oracle_robust<OracleT>(mapped_addr,select_addr,10);
+    }catch (const OracleMiss&){
+      throw;
+    }catch (...){
+      PLOG_DEBUG << "REMEASURE triggerd while dumping";
+    }
+  }
+}
 
-  // Open dumpfile
-  std::ofstream dumpfile;
-  dumpfile.open("measurements/allbits.csv");
-  dumpfile << "addr,class\n";
+/*
+* Class labels depend on the order the oracle discovered the classes in, so
+* every shard measures the same anchor entries. unscatter-merge aligns the
+* labels of the shards with them.
+*/
+template <typename AddrT, typename OracleT>
+void NaiveFramework<AddrT, OracleT>::dump_anchors(const std::vector<uint64_t>& bit_idx_reduce, pointer fixed,
+                                                  size_t iterations, std::string path){
+  RingWriter<dump_record> anchorfile(path, DUMP_HEADER, format_dump_record);
+  for (auto x : shard_anchors(iterations))
+  {
+    std::pair<pointer,bool> addr_tuple;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      this->addr->init_bitmask_iterator(this->input_space_bits[0], fixed | addr_from_idx_vec_and_idx(bit_idx_reduce, x));
+      addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+    }
+    if(!addr_tuple.second){
+      continue;
+    }
+    auto oracle_out = measure_robust(this->addr->map_addr(addr_tuple.first), addr_tuple.first);
+    anchorfile.push(dump_record{addr_tuple.first, oracle_out, true, this->oracle->margin()});
+  }
+}
+
+/*
+* Dumps truth tables for all relevant bits
+*/
+template <typename AddrT, typename OracleT>
+void NaiveFramework<AddrT, OracleT>::dump_truth_table(){
+  if(this->two_pass){
+    PLOG_WARNING << "Two pass dumps need a direct oracle, dumping with robust measurements only";
+  }
 
-  // Init bitmask iterator
-  this->addr->init_bitmask_iterator(this->input_space_bits[0]);
 
   // Reduce by applying lower and upper bit bounds
   auto reduce = 0;
@@ -155,44 +215,57 @@ void NaiveFramework::dump_truth_table(){
   }
   size_t iterations = 1L << (this->input_space_bits[0].size()-reduce);
 
-  
-  PLOG_INFO << "Dumping h naively, iteration count " << iterations;
+  // Tiling fixes the bits outside the limits to each assignment in turn,
+  // without it they stay zero
+  size_t tiles = this->tile ? 1ULL << bit_idx_expand.size() : 1;
+  auto range = shard_range(iterations, this->shard);
+  PLOG_INFO << "Dumping h naively, iteration count " << iterations << (this->tile ? " in " + std::to_string(tiles) + " tiles" : "")
+            << (this->shard.shards > 1 ? ", entries " + std::to_string(range.first) + " to " + std::to_string(range.second) : "");
+  Progress::begin_run((range.second - range.first) * tiles);
+  if(this->tile){
+    this->manifest.reset(new TileManifest(this->output_dir));
+  }
 
-  // Iterate over addresses dumping truth table
-  int perc = 0, last_perc = -1;
-  for (size_t i = 0; i < iterations ; i++)
+  for (size_t tile = 0; tile < tiles; tile++)
   {
-    // Try to determine output class of an address
-    auto addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
-    pointer select_addr = addr_tuple.first;
-    bool can_map = addr_tuple.second;
-    if(!can_map){
-      dumpfile << select_addr << ", "<< "-" << "\n";
-    }else{
-      int count = 0;
-      // Try to map an address
-      auto mapped_addr = this->addr->map_addr(select_addr);
-      // Try to measure until succesfull
-      bool oracle_success = false;
-      uint64_t oracle_out = 0;
-      while (!oracle_success)
+    // Open dumpfile, it is written by a housekeeping thread
+    auto path = this->tile ? this->manifest->add(-1, tile, bit_idx_expand) : this->output_dir + "/allbits.csv";
+    if(this->shard.shards > 1){
+      dump_anchors(bit_idx_reduce, tile_assignment(bit_idx_expand, tile), iterations,
+                   path.substr(0, path.size() - 4) + ".anchors.csv");
+    }
+    DumpWriter dumpfile(path, this->pla, bit_idx_reduce, -1, this->output_classes);
+
+    // Init bitmask iterator at the first entry of the shard
+    this->addr->init_bitmask_iterator(this->input_space_bits[0], tile_assignment(bit_idx_expand, tile) |
+                                      addr_from_idx_vec_and_idx(bit_idx_reduce, range.first));
+    Progress::begin_table(-1, range.second - range.first);
+
+    // Iterate over addresses dumping truth table
+    for (size_t i = range.first; i < range.second; i++)
+    {
+      // Try to determine output class of an address
+      std::pair<pointer,bool> addr_tuple;
       {
-        try{
-        // This can error if the maximum retry  is exceeded
-        oracle_out = this->oracle->oracle_robust(mapped_addr,select_addr,10); 
-        //std::cout << ((oracle_out>>bit_idx) & 0x1) << "\n"; 
-        dumpfile << select_addr << ", "<< oracle_out << "\n";
-        oracle_success = true;
-        }catch (...){
-          PLOG_DEBUG << "REMEASURE triggerd while dumping";
-        }
+        MetricsTimer timer(COUNTER_ADDR_NS);
+        addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+      }
+      pointer select_addr = addr_tuple.first;
+      bool can_map = addr_tuple.second;
+      Metrics::add(COUNTER_ENTRIES);
+      if(!can_map){
+        Metrics::add(COUNTER_UNMAPPABLE);
+        MetricsTimer timer(COUNTER_IO_NS);
+        dumpfile.push(dump_record{select_addr, 0, false, 0});
+      }else{
+        // Try to map an address
+        auto mapped_addr = this->addr->map_addr(select_addr);
+        auto oracle_out = measure_robust(mapped_addr, select_addr);
+        MetricsTimer timer(COUNTER_IO_NS);
+        dumpfile.push(dump_record{select_addr, oracle_out, true, this->oracle->margin()});
       }
-    }
       
-    perc = (int)(i * 100.0 / iterations);
-    if(perc != last_perc) {
-      PLOG_DEBUG << perc <<"% " << i << "/" << iterations;
-      last_perc = perc;
+      Progress::advance();
     }
   }
 }
@@ -200,7 +273,8 @@ void NaiveFramework::dump_truth_table(){
 /*
  * Performs a dry run without measurements, good for debugging
  */
-void NaiveFramework::dry_run(){
+template <typename AddrT, typename OracleT>
+void NaiveFramework<AddrT, OracleT>::dry_run(){
   uint64_t unmappable = 0;
   // Init bitmask iterator
   this->addr->init_bitmask_iterator(this->input_space_bits[0]);
@@ -220,31 +294,47 @@ void NaiveFramework::dry_run(){
   size_t iterations = 1L << (this->input_space_bits[0].size()-reduce);
 
   PLOG_INFO << "Dry run on h naive iteration count " << iterations;
+  Progress::begin_run(iterations);
+  Progress::begin_table(-1, iterations);
   // Iterate over addresses dumping truth table
-  int perc = 0, last_perc = -1;
   for (size_t i = 0; i < iterations ; i++)
   {
     // Try to determine output class of an address
-    auto addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+    std::pair<pointer,bool> addr_tuple;
+    {
+      MetricsTimer timer(COUNTER_ADDR_NS);
+      addr_tuple = this->addr->advance_bitmask_iterator(1ULL << (bit_idx_reduce[0]));
+    }
     pointer select_addr = addr_tuple.first;
     bool can_map = addr_tuple.second;
+    Metrics::add(COUNTER_ENTRIES);
     if(!can_map){
+      Metrics::add(COUNTER_UNMAPPABLE);
       unmappable++;
     }
       
-    perc = (int)(i * 100.0 / iterations);
-    if(perc != last_perc) {
-      PLOG_DEBUG << perc <<"% " << i << "/" << iterations;
-      last_perc = perc;
-    }
+    Progress::advance();
   }
   PLOG_INFO << unmappable << " Addresses not mappable when dumping all function bits";
 }
 
+/*
+ * Checks a candidate function on random addresses, class labels are matched to
+ * hash values
+ */
+template <typename AddrT, typename OracleT>
+bool NaiveFramework<AddrT, OracleT>::verify(const HashFunction& function, size_t samples){
+  Verification verification(function, false, this->output_dir);
+  return verification.run(this->addr, samples, [this](pointer mapped_addr, pointer select_addr){
+    return measure_robust(mapped_addr, select_addr);
+  });
+}
+
 /*
  * Initializer for the framework that allows to pin the code to a core.
  */
-NaiveFramework::NaiveFramework(int core, IAddr* addr, Oracle* oracle) {
+template <typename AddrT, typename OracleT>
+NaiveFramework<AddrT, OracleT>::NaiveFramework(int core, AddrT* addr, OracleT* oracle) {
   // Set selected oracle and address type
   this->addr = addr;
   this->oracle = oracle;
@@ -254,8 +344,17 @@ NaiveFramework::NaiveFramework(int core, IAddr* addr, Oracle* oracle) {
   sched_setaffinity(getpid(), sizeof(cpu_set_t), &mask);
 }
 
-NaiveFramework::~NaiveFramework() {
-  delete this->addr;
+template <typename AddrT, typename OracleT>
+NaiveFramework<AddrT, OracleT>::~NaiveFramework() {
+  if(this->owns_addr){
+    delete this->addr;
+  }
   delete this->oracle;
 }
 
+
+// Address pool and oracle combinations the framework is built for
+template class NaiveFramework<IAddr, Oracle>;
+template class NaiveFramework<VirtAddr, UtagOracle>;
+template class NaiveFramework<PhysAddr, DramaOracle>;
+template class NaiveFramework<SimAddr, SimOracle>;
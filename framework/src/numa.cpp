@@ -0,0 +1,189 @@
+#include <dirent.h>
+#include <sched.h>
+#include <x86intrin.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <plog/Log.h>
+
+#include "../include/numa.hpp"
+
+/*
+ * Parses a sysfs cpu list like 0-15,32-47
+ */
+static std::vector<int> parse_cpu_list(std::string list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string part;
+  while (std::getline(ss, part, ',')) {
+    if (part.empty() || part == "\n") {
+      continue;
+    }
+    auto dash = part.find('-');
+    int lower = std::stoi(part.substr(0, dash));
+    int upper = dash == std::string::npos ? lower : std::stoi(part.substr(dash + 1));
+    for (int cpu = lower; cpu <= upper; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/*
+ * Assigns the RAM ranges to the NUMA nodes that hold their memory blocks. A
+ * system without NUMA information has a single node with all ranges.
+ */
+std::vector<numa_node> get_numa_nodes(const boost::icl::interval_set<pointer>& ram_ranges) {
+  std::vector<numa_node> nodes;
+  uint64_t block_size = 0;
+  std::ifstream block_file(NUMA_SYSFS_BLOCK_SIZE);
+  block_file >> std::hex >> block_size;
+
+  DIR* node_dir = opendir(NUMA_SYSFS_NODES);
+  if (node_dir && block_size) {
+    struct dirent* node_entry;
+    while ((node_entry = readdir(node_dir)) != NULL) {
+      std::string name = node_entry->d_name;
+      if (name.rfind("node", 0) != 0 || name.size() == 4 || !isdigit(name[4])) {
+        continue;
+      }
+      numa_node node{std::stoi(name.substr(4)), {}, {}};
+      std::string path = std::string(NUMA_SYSFS_NODES) + "/" + name;
+      std::string cpulist;
+      std::ifstream cpu_file(path + "/cpulist");
+      std::getline(cpu_file, cpulist);
+      node.cpus = parse_cpu_list(cpulist);
+
+      // Memory blocks of the node are listed as memory<index>
+      boost::icl::interval_set<pointer> blocks;
+      DIR* block_dir = opendir(path.c_str());
+      struct dirent* block_entry;
+      while (block_dir && (block_entry = readdir(block_dir)) != NULL) {
+        std::string block = block_entry->d_name;
+        if (block.rfind("memory", 0) != 0 || block.size() == 6 || !isdigit(block[6])) {
+          continue;
+        }
+        pointer index = std::stoull(block.substr(6));
+        blocks += boost::icl::discrete_interval<pointer>::right_open(index * block_size, (index + 1) * block_size);
+      }
+      if (block_dir) {
+        closedir(block_dir);
+      }
+      node.ram_ranges = ram_ranges & blocks;
+      nodes.push_back(node);
+    }
+    closedir(node_dir);
+  }
+
+  if (nodes.empty()) {
+    PLOG_WARNING << "No NUMA information found, treating memory as a single node";
+    nodes.push_back(numa_node{0, ram_ranges, {}});
+  }
+  std::sort(nodes.begin(), nodes.end(), [](const numa_node& a, const numa_node& b) { return a.node < b.node; });
+  for (auto& node : nodes) {
+    PLOG_INFO << "NUMA node " << node.node << ": " << boost::icl::size(node.ram_ranges) << " bytes of RAM, "
+              << node.cpus.size() << " cores";
+  }
+  return nodes;
+}
+
+/*
+ * Picks a measurement core per node, the given core for its own node and the
+ * first core of every other node that is not used for housekeeping
+ */
+NumaScheduler::NumaScheduler(std::vector<numa_node> nodes, int core, int housekeeping_core) {
+  this->nodes = nodes;
+  this->stats.resize(this->nodes.size() + 1, node_stats{0, 0});
+  for (auto& node : this->nodes) {
+    int local = -1;
+    if (std::find(node.cpus.begin(), node.cpus.end(), core) != node.cpus.end()) {
+      local = core;
+    } else {
+      for (auto cpu : node.cpus) {
+        if (cpu != housekeeping_core) {
+          local = cpu;
+          break;
+        }
+      }
+    }
+    this->node_core.push_back(local);
+    PLOG_INFO << "Measuring addresses of NUMA node " << node.node << " on core " << local;
+  }
+  this->current_range = boost::icl::discrete_interval<pointer>();
+  this->current_node = this->nodes.size();
+  this->current_core = core;
+  this->last_tsc = 0;
+  this->migrations = 0;
+}
+
+/*
+ * Returns the index of the node holding an address, the node count if none
+ * does, and remembers the range the address lies in
+ */
+size_t NumaScheduler::find_node(pointer addr) {
+  for (size_t n = 0; n < this->nodes.size(); n++) {
+    auto range = this->nodes[n].ram_ranges.find(addr);
+    if (range != this->nodes[n].ram_ranges.end()) {
+      this->current_range = *range;
+      return n;
+    }
+  }
+  this->current_range = boost::icl::discrete_interval<pointer>::closed(addr, addr);
+  return this->nodes.size();
+}
+
+/*
+ * Called before the measurement of an address, migrates the calling thread if
+ * the address belongs to another node than the previous one
+ */
+void NumaScheduler::schedule(pointer addr) {
+  uint64_t now = __rdtsc();
+  if (this->last_tsc) {
+    this->stats[this->current_node].cycles += now - this->last_tsc;
+  }
+  this->last_tsc = now;
+
+  if (!boost::icl::contains(this->current_range, addr)) {
+    this->current_node = find_node(addr);
+  }
+  this->stats[this->current_node].entries++;
+  if (this->current_node == this->nodes.size()) {
+    return;
+  }
+  int core = this->node_core[this->current_node];
+  if (core < 0 || core == this->current_core) {
+    return;
+  }
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(core, &mask);
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &mask)) {
+    PLOG_WARNING << "Could not move measurement to core " << core;
+    this->node_core[this->current_node] = -1;
+    return;
+  }
+  this->current_core = core;
+  this->migrations++;
+}
+
+/*
+ * Logs the entries and the mean cycles per entry of every node and writes them
+ * to the output directory
+ */
+void NumaScheduler::report(std::string output_dir) {
+  std::ofstream out(output_dir + "/" NUMA_STATS_FILE);
+  out << "node,core,entries,cycles_per_entry\n";
+  for (size_t n = 0; n <= this->nodes.size(); n++) {
+    int node = n < this->nodes.size() ? this->nodes[n].node : -1;
+    int core = n < this->nodes.size() ? this->node_core[n] : -1;
+    auto& stats = this->stats[n];
+    if (!stats.entries) {
+      continue;
+    }
+    uint64_t per_entry = stats.cycles / stats.entries;
+    PLOG_INFO << "NUMA node " << node << ": " << stats.entries << " entries on core " << core << ", " << per_entry
+              << " cycles per entry";
+    out << node << "," << core << "," << stats.entries << "," << per_entry << "\n";
+  }
+  PLOG_INFO << "Measurement moved between nodes " << this->migrations << " times";
+}
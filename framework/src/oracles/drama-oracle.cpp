@@ -14,6 +14,7 @@
 
 #define ALLIGN_PAGE(a) (a & ~(4096-1)) + 4096
 #define FIXPOINT_DRAM 100
+#define DRAMA_THRESHOLD_WINDOW 1024 // timings per drift test of the threshold
 
 void DramaOracle::build_oracle(){
     // Set up initial address
@@ -25,6 +26,7 @@ void DramaOracle::build_oracle(){
     while(unchanged_iterations < FIXPOINT_DRAM){
       auto rand_addr = ALLIGN_PAGE(this->addr->get_random_addr());
       auto rand_addr_mapped = this->addr->map_addr(rand_addr);
+      AddrPin pin(this->addr, rand_addr);
       bool is_new_class = true;
       // Iterate over all previously seen classes
       for (size_t i = 0; i < this->class_examples.size(); i++)
@@ -69,6 +71,13 @@ DramaOracle::DramaOracle(int runs, int confidence, IAddr* addr) : Oracle(runs,co
   determine_treshold();
   PLOG_INFO << "Treshold set to " << this->threshold;  
   build_oracle();
+  // Every measurement accesses all class examples
+  size_t examples = 0;
+  for (auto& examples_of_class : this->class_examples)
+  {
+    examples += examples_of_class.size();
+  }
+  this->addr->reserve_mappings(examples);
 }
 
 DramaOracle::~DramaOracle()
@@ -77,13 +86,16 @@ DramaOracle::~DramaOracle()
 }
 
 uint64_t DramaOracle::oracle(pointer addr){
+  // Mapping the class examples must not unmap the measured address
+  AddrPin pin(this->addr, this->addr->unmap_addr(addr));
   addr = ALLIGN_PAGE(addr);
+  this->threshold = this->estimator->get();
   int hist[this->class_examples.size()] = {0};
   for (size_t i = 0; i < this->class_examples.size(); i++)
   {
     for(auto class_example : this->class_examples[i]){
       auto class_map = this->addr->map_addr(class_example);
-      if(this->weak_drama_oracle((void*) class_map, (void*) addr,20)){
+      if(this->weak_drama_oracle((void*) class_map, (void*) addr,this->threshold)){
         hist[i]++;
       }
     }
@@ -107,12 +119,14 @@ void DramaOracle::determine_treshold(){
     uint64_t res = getTiming(rand_addr_mapped_1,rand_addr_mapped_2);
     measurements.push_back(res);
   }
-  this->threshold = ostsu_treshold(measurements);
+  this->estimator.reset(new StreamingThreshold(measurements, DRAMA_THRESHOLD_WINDOW));
+  this->threshold = this->estimator->get();
 }
 
 bool DramaOracle::weak_drama_oracle(void* address1, void* address2, size_t threshold)
 {
   auto timing = getTiming((pointer) address1, (pointer) address2);
+  this->estimator->add(timing);
   return timing > threshold;
 }
 
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <plog/Log.h>
+
+#include "../../include/oracle.hpp"
+#include "../../include/metrics.hpp"
+
+/*
+* Transition of the class label when one address bit is flipped
+*/
+typedef struct label_transition {
+  uint64_t from;
+  uint64_t to;
+  size_t bit;
+} label_transition;
+
+/*
+* Learns the codes from flip pairs of every address bit. A bit whose pairs
+* mostly keep the label does not change the hash. The label of a random
+* address gets code 0, codes then spread along the transitions, and a bit
+* whose xor is not known yet when it reaches a new label becomes the next
+* output bit. Throws if the labels do not form a group.
+*/
+LabelledOracle::LabelledOracle(Oracle* inner, IAddr* addr) : Oracle(inner->runs,inner->confidence)
+{
+  this->inner = inner;
+  std::vector<label_transition> transitions;
+  std::set<uint64_t> labels;
+  std::vector<bool> relevant(addr->maxbits, false);
+  for (size_t bit = 0; bit < addr->maxbits; bit++)
+  {
+    std::vector<label_transition> pairs;
+    try{
+      for (size_t p = 0; p < LABEL_PAIRS_PER_BIT; p++)
+      {
+        auto pair = addr->get_flip_pair(bit);
+        auto first = inner->oracle_robust(addr->map_addr(pair.first), pair.first, LABEL_RETRIES);
+        auto second = inner->oracle_robust(addr->map_addr(pair.second), pair.second, LABEL_RETRIES);
+        labels.insert(first);
+        labels.insert(second);
+        pairs.push_back(label_transition{first, second, bit});
+      }
+    }catch (const OracleMiss&){
+      throw;
+    }catch (const std::exception&){
+      // The bit cannot be flipped within the address pool
+      continue;
+    }
+    auto changed = std::count_if(pairs.begin(), pairs.end(), [](const label_transition& t){ return t.from != t.to; });
+    relevant[bit] = 2 * changed > (int64_t)pairs.size();
+    transitions.insert(transitions.end(), pairs.begin(), pairs.end());
+  }
+
+  // Xor of the code of every bit, irrelevant bits keep the code
+  std::vector<int64_t> flips(addr->maxbits, -1);
+  for (size_t bit = 0; bit < addr->maxbits; bit++)
+  {
+    if(!relevant[bit]){
+      flips[bit] = 0;
+    }
+  }
+  size_t output_bits = 0;
+  this->codes[transitions.empty() ? 0 : transitions[0].from] = 0;
+  while (true)
+  {
+    bool spread = true;
+    while (spread)
+    {
+      spread = false;
+      for (auto& t : transitions)
+      {
+        for (auto edge : {std::make_pair(t.from, t.to), std::make_pair(t.to, t.from)})
+        {
+          auto from = this->codes.find(edge.first);
+          if(from == this->codes.end()){
+            continue;
+          }
+          if(flips[t.bit] >= 0 && !this->codes.count(edge.second)){
+            this->codes[edge.second] = from->second ^ flips[t.bit];
+            spread = true;
+          }else if(flips[t.bit] < 0 && this->codes.count(edge.second)){
+            flips[t.bit] = from->second ^ this->codes[edge.second];
+            spread = true;
+          }
+        }
+      }
+    }
+    // A label that is still unreached needs a new output bit
+    auto next = std::find_if(transitions.begin(), transitions.end(), [this, &flips](const label_transition& t){
+      return flips[t.bit] < 0 && this->codes.count(t.from) != this->codes.count(t.to);
+    });
+    if(next == transitions.end()){
+      break;
+    }
+    flips[next->bit] = 1ULL << output_bits++;
+  }
+
+  // Contradicting transitions are noise as long as they are rare
+  size_t conflicts = 0;
+  for (auto& t : transitions)
+  {
+    if(!this->codes.count(t.from) || !this->codes.count(t.to) || flips[t.bit] < 0 ||
+       (this->codes[t.from] ^ this->codes[t.to]) != (uint64_t)flips[t.bit] ||
+       (t.from == t.to) != (flips[t.bit] == 0)){
+      conflicts++;
+    }
+  }
+  std::set<uint64_t> distinct;
+  for (auto& code : this->codes)
+  {
+    distinct.insert(code.second);
+  }
+  if(labels.size() != (1ULL << output_bits) || this->codes.size() != labels.size() || distinct.size() != labels.size() ||
+     conflicts > LABEL_MAX_CONFLICT_SHARE * transitions.size()){
+    std::throw_with_nested(std::runtime_error(std::to_string(labels.size()) + " classes do not form a group of " +
+                                              std::to_string(1ULL << output_bits) + " distinct codes, " + std::to_string(conflicts) +
+                                              "/" + std::to_string(transitions.size()) + " transitions contradict it"));
+  }
+  this->output_classes = 1ULL << output_bits;
+
+  std::stringstream masks;
+  for (size_t out = 0; out < output_bits; out++)
+  {
+    uint64_t mask = 0;
+    for (size_t bit = 0; bit < addr->maxbits; bit++)
+    {
+      mask |= (uint64_t)(((flips[bit] >> out) & 0x1) && relevant[bit]) << bit;
+    }
+    masks << (out ? ", " : "") << "h[" << out << "] 0x" << std::hex << mask << std::dec;
+  }
+  PLOG_INFO << "Relabelled " << labels.size() << " classes to " << output_bits << " output bits, " << conflicts << "/"
+            << transitions.size() << " transitions contradict the codes, " << masks.str();
+}
+
+LabelledOracle::~LabelledOracle()
+{
+  delete this->inner;
+}
+
+uint64_t LabelledOracle::oracle(pointer addr){
+  auto code = this->codes.find(this->inner->oracle(addr));
+  if(code == this->codes.end()){
+    Metrics::add(COUNTER_UNLABELLED);
+    throw OracleNoise("class was not seen while relabelling");
+  }
+  return code->second;
+}
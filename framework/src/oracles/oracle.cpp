@@ -1,15 +1,19 @@
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <plog/Log.h>
 
 
 #include "../../include/oracle.hpp"
+#include "../../include/metrics.hpp"
 
 Oracle::Oracle(int runs, int confidence){
   this->runs = runs;
   this->confidence = confidence;
+  this->output_classes = 0;
 }
 
+template <typename OracleT>
 uint64_t Oracle::oracle_robust(pointer addr, pointer paddr, int retries){
     if(this->output_classes == 0){
         std::throw_with_nested(std::runtime_error("Set output classes before starting robust measurement, output classes can also be set highter than required\n"));
@@ -17,20 +21,91 @@ uint64_t Oracle::oracle_robust(pointer addr, pointer paddr, int retries){
   #ifdef DEBUG
     std::cout << "\r" << std::hex << addr << " [0x" << paddr << "] " << std::dec;
   #endif
+  auto& hist = this->hist;
+  hist.resize(std::max(this->output_classes,(uint64_t)MAX_OUTPUT_CLASS_ASSUMPTION));
+  auto slot = Metrics::slot();
   for (size_t t = 0; t < retries; t++)
   {
-    std::vector<uint64_t> hist(std::max(this->output_classes,(uint64_t)MAX_OUTPUT_CLASS_ASSUMPTION),0);
-    for (size_t i = 0; i < this->runs; i++)
-    {
-      hist[this->oracle(addr)]++;
+    std::fill(hist.begin(), hist.end(), 0);
+    try{
+      this->timed_round<OracleT>(addr, this->runs, [&](uint64_t out) { hist[out]++; });
+    }catch (const OracleNoise& e){
+      slot.add(COUNTER_RETRIES);
+      PLOG_DEBUG << "Remeasure triggered for 0x" << std::hex << addr << " [0x" << paddr << "] " << std::dec << e.what();
+      continue;
     }
     auto it = std::max_element(hist.begin(), hist.end());
-    if(*it > this->confidence){
+    if(*it > this->confidence || (this->weak_confidence && *it > this->weak_confidence)){
+      if(*it <= this->confidence){
+        slot.add(COUNTER_WEAK_ACCEPTS);
+      }
+      slot.add(COUNTER_DECISIONS);
+      slot.record(HIST_VOTES, (t + 1) * this->runs);
       return std::distance(hist.begin(), it);
     }
     
+    slot.add(COUNTER_RETRIES);
     PLOG_DEBUG << "Remeasure triggered for 0x" << std::hex << addr << " [0x" << paddr << "] " << std::dec << " max was " << *it << "/" << runs;
   }
+  slot.add(COUNTER_EXCEPTIONS);
   std::throw_with_nested(std::runtime_error("Maximum retries for robust oracle exceeded.\n"));
   return 0; // Unreachable
 }
+
+/*
+* Votes of the winner of the last robust decision minus those of the runner up,
+* in percent of the votes of its deciding round
+*/
+uint32_t Oracle::margin(){
+  uint64_t first = 0, second = 0;
+  for (auto votes : this->hist)
+  {
+    if(votes > first){
+      second = first;
+      first = votes;
+    }else if(votes > second){
+      second = votes;
+    }
+  }
+  return this->runs ? (MARGIN_FULL * (first - second)) / this->runs : 0;
+}
+
+/*
+* Margin of one output bit in the last robust decision, the votes of all
+* classes that agree with the bit of the winning class, which is the one that
+* is dumped, against those that do not. It is 0 if the votes contradict the bit.
+*/
+uint32_t Oracle::bit_margin(size_t bit){
+  if(!this->runs || this->hist.empty()){
+    return 0;
+  }
+  uint64_t winner = std::distance(this->hist.begin(), std::max_element(this->hist.begin(), this->hist.end()));
+  int64_t agree = 0, total = 0;
+  for (size_t c = 0; c < this->hist.size(); c++)
+  {
+    agree += (((c ^ winner) >> bit) & 0x1) ? 0 : this->hist[c];
+    total += this->hist[c];
+  }
+  return (MARGIN_FULL * std::max<int64_t>(2 * agree - total, 0)) / this->runs;
+}
+
+/*
+* Single oracle call that is accounted in the metrics
+*/
+template <typename OracleT>
+uint64_t Oracle::timed_oracle(pointer addr){
+  uint64_t out = 0;
+  this->timed_round<OracleT>(addr, 1, [&](uint64_t o) { out = o; });
+  return out;
+}
+
+// Oracles the robust measurement is built for, Oracle dispatches at runtime
+#define INSTANTIATE_ORACLE(OracleT) \
+  template uint64_t Oracle::oracle_robust<OracleT>(pointer addr, pointer paddr, int retries); \
+  template uint64_t Oracle::timed_oracle<OracleT>(pointer addr);
+INSTANTIATE_ORACLE(Oracle)
+INSTANTIATE_ORACLE(SliceOracle)
+INSTANTIATE_ORACLE(SliceTimingOracle)
+INSTANTIATE_ORACLE(UtagOracle)
+INSTANTIATE_ORACLE(DramaOracle)
+INSTANTIATE_ORACLE(SimOracle)
@@ -0,0 +1,47 @@
+#include <sstream>
+#include <x86intrin.h>
+#include <plog/Log.h>
+
+#include "../../include/oracle.hpp"
+
+/*
+* Starts a trace, the address pool has to be seeded already
+*/
+RecordingOracle::RecordingOracle(Oracle* inner, IAddr* addr, std::string path, bool naive) : Oracle(inner->runs,inner->confidence)
+{
+  this->inner = inner;
+  this->addr = addr;
+  this->output_classes = inner->output_classes;
+
+  trace_header header{};
+  header.seed = addr->get_seed();
+  header.maxbits = addr->maxbits;
+  header.output_classes = inner->output_classes;
+  header.naive = naive;
+  boost::icl::interval_set<pointer> ranges;
+  auto range_addr = dynamic_cast<RangeAddr*>(addr);
+  if(range_addr){
+    header.addr_kind = TRACE_ADDR_RANGE;
+    ranges = range_addr->get_dram().ram_ranges;
+  }else{
+    header.addr_kind = TRACE_ADDR_VIRT;
+  }
+  std::ostringstream header_bytes;
+  write_trace_header(header_bytes, header, ranges);
+  this->trace.reset(new RingWriter<trace_record>(path, header_bytes.str(), format_trace_record));
+  PLOG_INFO << "Recording oracle responses to " << path << " with seed 0x" << std::hex << header.seed << std::dec;
+}
+
+RecordingOracle::~RecordingOracle()
+{
+  this->trace.reset();
+  delete this->inner;
+}
+
+uint64_t RecordingOracle::oracle(pointer addr){
+  auto start = __rdtsc();
+  auto result = this->inner->oracle(addr);
+  uint64_t cycles = __rdtsc() - start;
+  this->trace->push(trace_record{this->addr->unmap_addr(addr), (uint32_t)result, (uint32_t)std::min(cycles, (uint64_t)UINT32_MAX)});
+  return result;
+}
@@ -0,0 +1,36 @@
+#include <sstream>
+#include <plog/Log.h>
+
+#include "../../include/oracle.hpp"
+
+ReplayOracle::ReplayOracle(int runs, int confidence, trace_header header, std::vector<trace_record> records) : Oracle(runs,confidence)
+{
+  this->output_classes = header.output_classes;
+  for(auto& record : records){
+    this->responses[record.addr].push_back(record.result);
+  }
+  PLOG_INFO << "Replaying " << records.size() << " oracle responses for " << this->responses.size() << " addresses";
+}
+
+ReplayOracle::~ReplayOracle()
+{
+}
+
+/*
+* Addresses are identity mapped during a replay, so addr is the recorded address
+*/
+uint64_t ReplayOracle::oracle(pointer addr){
+  auto it = this->responses.find(addr);
+  if(it == this->responses.end()){
+    std::stringstream msg;
+    msg << "Address 0x" << std::hex << addr << " was not recorded";
+    throw OracleMiss(msg.str());
+  }
+  auto& pos = this->position[addr];
+  if(pos == it->second.size()){
+    std::stringstream msg;
+    msg << "All " << it->second.size() << " recorded responses for address 0x" << std::hex << addr << " are used up";
+    throw OracleMiss(msg.str());
+  }
+  return it->second[pos++];
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <algorithm>
+#include <plog/Log.h>
+
+#include "../../include/oracle.hpp"
+
+#define SIM_MAX_FLIP_PROBABILITY 0.5
+
+SimOracle::SimOracle(int runs, int confidence, HashFunction function, sim_noise noise, uint64_t seed) : Oracle(runs,confidence), rnd(seed)
+{
+  this->function = function;
+  this->noise = noise;
+  this->calls = 0;
+  this->burst_left = 0;
+  this->output_classes = 1ULL << function.bits.size();
+  PLOG_INFO << "Simulating " << function.bits.size() << " output bits, "
+            << (function.is_linear() ? "linear" : "nonlinear") << " function";
+  PLOG_INFO << "Flip probability " << noise.flip_probability << ", burst probability "
+            << noise.burst_probability << " for " << noise.burst_length << " calls, drift "
+            << noise.drift << "/M calls, latency " << noise.latency_ns << "ns";
+}
+
+SimOracle::~SimOracle()
+{
+}
+
+/*
+* True with the given probability
+*/
+bool SimOracle::flip(double probability){
+  if(probability <= 0){
+    return false;
+  }
+  return (double)(this->rnd() >> 11) * 0x1.0p-53 < probability;
+}
+
+uint64_t SimOracle::oracle(pointer addr){
+  // Simulate the time a measurement takes
+  if(this->noise.latency_ns){
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(this->noise.latency_ns);
+    while(std::chrono::steady_clock::now() < end);
+  }
+
+  // Select the error rate for this call
+  double probability = this->noise.flip_probability + this->noise.drift * (this->calls / 1e6);
+  if(this->burst_left > 0){
+    this->burst_left--;
+    probability = this->noise.burst_flip_probability;
+  }else if(this->noise.burst_length > 0 && flip(this->noise.burst_probability)){
+    this->burst_left = this->noise.burst_length - 1;
+    probability = this->noise.burst_flip_probability;
+  }
+  probability = std::min(probability, SIM_MAX_FLIP_PROBABILITY);
+  this->calls++;
+
+  uint64_t out = this->function.eval(addr);
+  for (size_t i = 0; i < this->function.bits.size(); i++)
+  {
+    if(flip(probability)){
+      out ^= 1ULL << i;
+    }
+  }
+  return out;
+}
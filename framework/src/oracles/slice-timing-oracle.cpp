@@ -11,6 +11,7 @@
 #include "../../include/utils.hpp"
 
 #define ALLIGN_PAGE(a) (a & ~(4096-1)) + 4096
+#define SLICE_TIMING_THRESHOLD_WINDOW 65536 // timings per drift test of the threshold
 
 
 SliceTimingOracle::SliceTimingOracle(int runs, int confidence, IAddr* addr) : Oracle(runs,confidence)
@@ -28,6 +29,7 @@ SliceTimingOracle::~SliceTimingOracle()
 
 uint64_t SliceTimingOracle::oracle(pointer addr){
   uint64_t hist[this->cores] = {0};
+  this->threshold = this->estimator->get();
   for (size_t i = 0; i < 5000; i++)
   {
     for (size_t c = 0; c < this->cores; c++)
@@ -37,6 +39,7 @@ uint64_t SliceTimingOracle::oracle(pointer addr){
       maccess((void*) addr);
       flush((void*) addr);
       size_t end = rdtsc(); 
+      this->estimator->add(end-start);
       if(end-start < this->threshold){
         hist[c]++;
       }
@@ -55,12 +58,13 @@ void SliceTimingOracle::determine_treshold(){
     {
       pin_to_core(getpid(), c);
       size_t start = rdtsc();
-      maccess((void*) addr);
-      flush((void*) addr);
+      maccess(rand_addr_mapped);
+      flush(rand_addr_mapped);
       size_t end = rdtsc();
       measurements.push_back(end-start); 
     }
   }
-  this->threshold = ostsu_treshold(measurements);
+  this->estimator.reset(new StreamingThreshold(measurements, SLICE_TIMING_THRESHOLD_WINDOW));
+  this->threshold = this->estimator->get();
 }
 
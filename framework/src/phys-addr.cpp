@@ -1,6 +1,7 @@
 #include <iterator>
 #include <bitset>
 #include <algorithm>
+#include <chrono>
 #include <plog/Log.h>
 
 #include "ptedit_header.h"
@@ -9,6 +10,8 @@
 #include "../include/utils.hpp"
 
 #define FIRST_LEVEL_ENTRIES 256 // only 256, because upper half is kernel
+#define PT_ENTRIES 512 // entries of one page table page
+#define PT_SPAN (PT_ENTRIES * 4096ULL) // bytes mapped by one page table page
 
 /*
 * True if present bit is set
@@ -145,9 +148,10 @@ dram_ctx get_dram_ctx() {
 
 /*
  * Init structures needed to map physical addresses
- * Addr set size defines the number of addresses that can be mapped in parralel
+ * With window bits set only the address space is reserved, windows of /dev/mem
+ * are mapped into it on demand and the least recently used ones are dropped
  */
-PhysAddr::PhysAddr() {
+PhysAddr::PhysAddr(size_t window_bits, size_t window_count) {
   // Init pteditor
   ptedit_init();
   // Get fitlered dram addresses
@@ -159,133 +163,270 @@ PhysAddr::PhysAddr() {
     PLOG_DEBUG<< std::hex << range << std::dec <<": " <<(range.upper() - range.lower()) << "b";
   }
   
+  this->numa_nodes = ::get_numa_nodes(this->dram.ram_ranges);
   this->maxbits = ceil(log2(this->dram.ram_addresses));
   PLOG_INFO <<  this->maxbits << " bits of physical memory can be mapped ";
   
   // Map all availiable physical memory
-  int fd = open("/dev/mem", O_RDONLY);
-  if(fd < 3) {
+  this->mem_fd = open("/dev/mem", O_RDONLY);
+  if(this->mem_fd < 3) {
       PLOG_FATAL << "Could not open /dev/mem! Did you load the kernel module and start as root?";
       exit(1);
   }
 
-  this->map_base = (char*) mmap(0, this->dram.ram_addresses*2, PROT_READ, MAP_SHARED, fd, 0);
+  this->window_bits = window_bits;
+  this->window_count = std::max<size_t>(window_count, PHYS_MIN_WINDOWS);
+  if(window_bits && window_count < PHYS_MIN_WINDOWS){
+    PLOG_WARNING << "Raising --phys-windows to " << PHYS_MIN_WINDOWS << ", measurements keep that many windows mapped at once";
+  }
+  this->last_window = (pointer)-1;
+  this->map_size = this->dram.ram_addresses*2;
+  if(this->window_bits){
+    // Whole windows, the page after the last address may be accessed as well
+    size_t window_size = 1ULL << this->window_bits;
+    this->map_size = ((this->map_size + window_size - 1) & ~(window_size - 1)) + window_size;
+    this->map_base = (char*) mmap(0, this->map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }else{
+    this->map_base = (char*) mmap(0, this->map_size, PROT_READ, MAP_SHARED, this->mem_fd, 0);
+  }
   assert(this->map_base != MAP_FAILED);
   if(this->map_base == (char*)-1 || this->map_base == NULL) {
       PLOG_FATAL << "Could not map physical memory!";
       exit(1);
   }
   PLOG_INFO << "Physical memory mapped at base address: 0x"<< std::hex << (uint64_t) this->map_base << std::dec;
+  if(this->window_bits){
+    PLOG_INFO << "Mapping up to " << this->window_count << " windows of " << (1ULL << this->window_bits) << " bytes on demand";
+  }
 }
 
 /*
- * Remove ptedit
+ * Maps a window of /dev/mem into the reserved address space. It is populated
+ * right away so the page faults do not end up in a measurement, and the least
+ * recently used window that is not pinned makes room for it.
  */
-PhysAddr::~PhysAddr() {
-  munmap(this->map_base, this->dram.ram_addresses*2);
-  ptedit_cleanup();
+void PhysAddr::map_window(pointer window){
+  size_t window_size = 1ULL << this->window_bits;
+  if(this->windows.size() >= this->window_count){
+    auto victim = std::prev(this->window_lru.end());
+    while(this->pinned_windows.count(*victim)){
+      if(victim == this->window_lru.begin()){
+        PLOG_FATAL << "All " << this->window_count << " windows are pinned, raise --phys-windows";
+        exit(1);
+      }
+      victim--;
+    }
+    pointer evicted = *victim;
+    this->window_lru.erase(victim);
+    this->windows.erase(evicted);
+    if(evicted == this->last_window){
+      this->last_window = (pointer)-1;
+    }
+    // Replacing the window by a reservation frees its page tables
+    mmap(this->map_base + evicted * window_size, window_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+  }
+  if(mmap(this->map_base + window * window_size, window_size, PROT_READ, MAP_SHARED | MAP_FIXED | MAP_POPULATE, this->mem_fd, window * window_size) == MAP_FAILED){
+    PLOG_FATAL << "Could not map physical memory window 0x" << std::hex << window * window_size << std::dec << "!";
+    exit(1);
+  }
+  this->window_lru.push_front(window);
+  this->windows[window] = this->window_lru.begin();
+
+  // Fresh mappings are cachable, restore the memory type of uncachable ranges
+  boost::icl::interval_set<pointer> window_range;
+  window_range += boost::icl::discrete_interval<pointer>::right_open(window * window_size, (window + 1) * window_size);
+  auto uncachable = window_range & this->uncachable_ranges;
+  if(!uncachable.empty()){
+    switch_memory_type(uncachable, ptedit_find_first_mt(PTEDIT_MT_UC));
+  }
 }
 
 /*
- * Checks if the address maps to a valid dram range
+ * Remove ptedit
  */
-bool PhysAddr::valid_address(pointer addr){
-    return this->dram.ram_ranges.find(addr) != this->dram.ram_ranges.end();
+PhysAddr::~PhysAddr() {
+  munmap(this->map_base, this->map_size);
+  close(this->mem_fd);
+  ptedit_cleanup();
 }
 
-
 /*
-* Maps an address and returns a pointer to the mapping
+* Maps an address and returns a pointer to the mapping. In windowed mode the
+* pointer stays valid until window_count other windows have been mapped or as
+* long as the address is pinned, the window of the following page is mapped
+* too as oracles align to it.
 */
 pointer PhysAddr::map_addr(pointer addr){
+  if(this->window_bits){
+    for(pointer window : {addr >> this->window_bits, (addr + 4096) >> this->window_bits}){
+      // Consecutive addresses mostly share a window, refresh it without the lookup
+      if(window == this->last_window){
+        this->window_lru.splice(this->window_lru.begin(), this->window_lru, this->last_window_lru);
+        continue;
+      }
+      auto it = this->windows.find(window);
+      if(it == this->windows.end()){
+        map_window(window);
+      }else{
+        this->window_lru.splice(this->window_lru.begin(), this->window_lru, it->second);
+      }
+    }
+    this->last_window = addr >> this->window_bits;
+    this->last_window_lru = this->windows[this->last_window];
+  }
   return (pointer)(this->map_base + addr);
 }
 
-void PhysAddr::make_uncachable(){
-  PLOG_INFO << "Making memory uncachable";
-  int uc_mt = ptedit_find_first_mt(PTEDIT_MT_UC);
-  for(auto range: dram.ram_ranges){
-    for(size_t offset = range.lower(); offset < range.upper(); offset+=4096){
-        pointer vaddr = map_addr(offset);
-        ptedit_entry_t entry = ptedit_resolve((void*)vaddr, 0);
-        entry.pte = ptedit_apply_mt(entry.pte, uc_mt);
-        entry.valid = PTEDIT_VALID_MASK_PTE;
-        ptedit_update((void*)vaddr, 0, &entry);
+/*
+* Keeps the windows of a mapped address and its following page mapped until it
+* is unpinned, pins nest
+*/
+void PhysAddr::pin_addr(pointer addr){
+  if(this->window_bits){
+    for(pointer window : {addr >> this->window_bits, (addr + 4096) >> this->window_bits}){
+      this->pinned_windows[window]++;
     }
   }
 }
 
-void PhysAddr::make_cachable(){
-  PLOG_INFO << "Making memory cachable";
-  int wb_mt = ptedit_find_first_mt(PTEDIT_MT_WB); 
-  for(auto range: dram.ram_ranges){
-    for(size_t offset = range.lower(); offset < range.upper(); offset+=4096){
-        pointer vaddr = map_addr(offset);
-        ptedit_entry_t entry = ptedit_resolve((void*)vaddr, 0);
-        entry.pte = ptedit_apply_mt(entry.pte, wb_mt);
-        entry.valid = PTEDIT_VALID_MASK_PTE;
-        ptedit_update((void*)vaddr, 0, &entry);
+void PhysAddr::unpin_addr(pointer addr){
+  if(this->window_bits){
+    for(pointer window : {addr >> this->window_bits, (addr + 4096) >> this->window_bits}){
+      auto it = this->pinned_windows.find(window);
+      if(it != this->pinned_windows.end() && --it->second == 0){
+        this->pinned_windows.erase(it);
+      }
     }
   }
 }
 
 /*
- * Returns a random physical address
- * This can potentially be optimized by directky returning a valid address from one of the intervals
- */
-pointer PhysAddr::get_random_addr(){
-    // Select address smaller than max dram range
-    int range_select = this->rnd(this->dram.ram_ranges.iterative_size());
-    auto range_it = *std::next(this->dram.ram_ranges.begin(), range_select);
-    auto range_delta = range_it.upper()-range_it.lower();
-    int low = contains(range_it, lower(range_it)) ? 0 : 1;
-    int up = contains(range_it, upper(range_it)) ? 0 : 1;
-    pointer addr = (range_it.lower() + low) + (this->rnd(range_delta-up));
-   
-    if(!valid_address(addr)){
-        PLOG_FATAL << "Invalid physical address selected: " << range_select << " " << range_it << " " << addr << " " << (addr&0x11111) << " " << range_delta << "\n";
-        exit(1);
-    }
-    return addr;
+* Raises the window count so that addrs addresses an oracle maps during every
+* measurement stay mapped next to the measured ones instead of being remapped
+* for each measurement
+*/
+void PhysAddr::reserve_mappings(size_t addrs){
+  size_t needed = 2 * addrs + PHYS_MIN_WINDOWS;
+  if(this->window_bits && this->window_count < needed){
+    PLOG_INFO << "Raising the window count from " << this->window_count << " to " << needed << " to keep the "
+              << addrs << " addresses of the oracle mapped";
+    this->window_count = needed;
+  }
 }
 
+/*
+* Returns the NUMA nodes the RAM ranges belong to
+*/
+const std::vector<numa_node>& PhysAddr::get_numa_nodes() const{
+  return this->numa_nodes;
+}
 
 /*
-* Advances the bitmask iterator returning an address
+* Returns the physical address of a pointer into the mapping
 */
-std::pair<pointer,bool> PhysAddr::advance_bitmask_iterator(size_t step) {
+pointer PhysAddr::unmap_addr(pointer mapped){
+  return mapped - (pointer)this->map_base;
+}
 
-  auto addr=this->bitmsask_iterator_position;
+/*
+* Applies a memory type to the mapping of a physical range. Page table pages
+* are read, edited and written back as a whole and huge pages are updated at
+* the PMD level, so the kernel is entered once per 2M instead of once per 4K.
+* A huge page that is only partly inside the range changes as a whole.
+* The range has to be mapped, it is not mapped here as that could map and
+* evict other windows. Returns the number of page table writes, the TLB is
+* not flushed.
+*/
+size_t PhysAddr::apply_memory_type(pointer lower, pointer upper, int mt){
+  size_t pagesize = ptedit_get_pagesize();
+  size_t pt[PT_ENTRIES];
+  size_t writes = 0;
+  pointer vaddr = ((pointer)this->map_base + lower) & ~(pointer)(pagesize - 1);
+  pointer vend = (pointer)this->map_base + upper;
+  while(vaddr < vend){
+    pointer chunk_end = std::min<pointer>((vaddr & ~(PT_SPAN - 1)) + PT_SPAN, vend);
+    ptedit_entry_t entry = ptedit_resolve((void*)vaddr, 0);
+    if(is_present(entry.pmd) && !is_normal_page(entry.pmd)){
+      entry.pmd = ptedit_apply_mt_huge(entry.pmd, mt);
+      entry.valid = PTEDIT_VALID_MASK_PMD;
+      ptedit_update((void*)vaddr, 0, &entry);
+      writes++;
+    } else if(is_present(entry.pmd)){
+      size_t pt_pfn = ptedit_get_pfn(entry.pmd);
+      ptedit_read_physical_page(pt_pfn, (char *)pt);
+      for(size_t pti = (vaddr / pagesize) % PT_ENTRIES; pti <= ((chunk_end - 1) / pagesize) % PT_ENTRIES; pti++){
+        if(is_present(pt[pti])){
+          pt[pti] = ptedit_apply_mt(pt[pti], mt);
+        }
+      }
+      ptedit_write_physical_page(pt_pfn, (char *)pt);
+      writes++;
+    }
+    vaddr = chunk_end;
+  }
+  return writes;
+}
 
-  auto addr_max_bm = this->bitmsask_iterator_position;
-  for(auto idx : this->idx_vec_invert){
-      addr_max_bm |= (1L << idx);
+/*
+* Applies a memory type to a set of physical ranges and flushes the TLB once.
+* Reloading the paging root of the process drops all of its TLB entries.
+* In windowed mode only mapped windows are edited, map_window applies the
+* memory type to the others once they are mapped.
+*/
+void PhysAddr::switch_memory_type(const boost::icl::interval_set<pointer>& ranges, int mt){
+  auto start = std::chrono::steady_clock::now();
+  size_t writes = 0;
+  auto mapped = ranges;
+  if(this->window_bits){
+    boost::icl::interval_set<pointer> windows;
+    for(auto& window : this->windows){
+      windows += boost::icl::discrete_interval<pointer>::right_open(window.first << this->window_bits,
+                                                                    (window.first + 1) << this->window_bits);
+    }
+    mapped &= windows;
   }
-  auto bitmask_range = boost::icl::discrete_interval<pointer>::closed(addr, addr_max_bm);
-  auto intersect = bitmask_range & this->dram.ram_ranges;
-  if(intersect.empty()){
-    this->bitmsask_iterator_position = ((this->bitmsask_iterator_position | ~this->bitmask) + step) & this->bitmask;
-    //PLOG_ERROR << "Address [" << std::hex << this->bitmsask_iterator_position << std::dec <<"] cannot be mapped";
-    return std::make_pair(addr,false);
+  for(auto range: mapped){
+    writes += apply_memory_type(range.lower(), range.upper(), mt);
   }
-
-  auto addr_new = addr;
-  while(!(valid_address(addr_new))){
-    addr_new = flip_unused_bits(addr);
-    PLOG_VERBOSE << "Flipping physical address bits from " << std::hex << addr << std::dec << " to " << std::hex << addr_new << std::dec;
+  if(writes){
+    ptedit_full_serializing_barrier();
+    ptedit_set_paging_root(0, ptedit_get_paging_root(0));
+    ptedit_full_serializing_barrier();
   }
-  addr=addr_new;
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  PLOG_DEBUG << "Switched " << boost::icl::size(mapped) << " bytes to memory type " << mt << " with " << writes
+             << " page table writes in " << duration.count() << "us";
+}
 
-  // increment bitmask
-  this->bitmsask_iterator_position = ((this->bitmsask_iterator_position | ~this->bitmask) + step) & this->bitmask;
-  // Return found address
-  return std::make_pair(addr,true);
+/*
+* Makes the mapping of a physical window uncachable, pages that already are
+* uncachable are not touched
+*/
+void PhysAddr::make_uncachable(pointer lower, pointer upper){
+  boost::icl::interval_set<pointer> window;
+  window += boost::icl::discrete_interval<pointer>::right_open(lower, upper);
+  auto ranges = (window & this->dram.ram_ranges) - this->uncachable_ranges;
+  switch_memory_type(ranges, ptedit_find_first_mt(PTEDIT_MT_UC));
+  this->uncachable_ranges += ranges;
 }
 
 /*
-* Flips bit no in the bitmask iterator to get a usable address
+* Makes the mapping of a physical window cachable again
 */
-pointer PhysAddr::flip_unused_bits(pointer addr){
-  auto rand_mask = (this->rnd() & ~this->bitmask) & (((uint64_t) 1 << this->maxbits) - 1);
-  return rand_mask ^ addr;
+void PhysAddr::make_cachable(pointer lower, pointer upper){
+  boost::icl::interval_set<pointer> window;
+  window += boost::icl::discrete_interval<pointer>::right_open(lower, upper);
+  auto ranges = window & this->uncachable_ranges;
+  switch_memory_type(ranges, ptedit_find_first_mt(PTEDIT_MT_WB));
+  this->uncachable_ranges -= ranges;
+}
+
+void PhysAddr::make_uncachable(){
+  PLOG_INFO << "Making memory uncachable";
+  make_uncachable(0, this->dram.max_address + 1);
+}
+
+void PhysAddr::make_cachable(){
+  PLOG_INFO << "Making memory cachable";
+  make_cachable(0, this->dram.max_address + 1);
 }
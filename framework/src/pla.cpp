@@ -0,0 +1,82 @@
+#include <fcntl.h>
+#include <charconv>
+#include <iostream>
+#include <plog/Log.h>
+
+#include "../include/pla.hpp"
+#include "../include/utils.hpp"
+
+/*
+ * Formats a cube as "<inputs> <outputs>", the first relevant bit is the
+ * leftmost input
+ */
+size_t format_pla_record(char* out, const pla_record& record) {
+  char* pos = out;
+  for (size_t i = 0; i < record.inputs; i++) {
+    *pos++ = '0' + ((record.cube >> i) & 0x1);
+  }
+  *pos++ = ' ';
+  for (size_t o = 0; o < record.outputs; o++) {
+    if (!record.care) {
+      *pos++ = '-';
+    } else if (record.encoding == PLA_ONE_HOT) {
+      *pos++ = record.value == o ? '1' : '0';
+    } else {
+      *pos++ = '0' + ((record.value >> o) & 0x1);
+    }
+  }
+  *pos++ = '\n';
+  return pos - out;
+}
+
+PlaWriter::PlaWriter(std::string path, const std::vector<uint64_t>& bits, pla_encoding encoding, uint64_t classes,
+                     uint32_t min_margin, uint64_t bit) {
+  this->bits = bits;
+  this->encoding = encoding;
+  this->min_margin = min_margin;
+  uint64_t outputs = 1;
+  if (encoding == PLA_ONE_HOT) {
+    outputs = classes;
+  } else if (encoding == PLA_BINARY) {
+    while ((1ULL << outputs) < classes) {
+      outputs++;
+    }
+  }
+  if (bits.size() > PLA_MAX_INPUTS || outputs > PLA_MAX_OUTPUTS || outputs == 0) {
+    std::throw_with_nested(std::runtime_error(path + ": a PLA supports up to " + std::to_string(PLA_MAX_INPUTS) +
+                                              " inputs and " + std::to_string(PLA_MAX_OUTPUTS) + " outputs"));
+  }
+  this->outputs = outputs;
+
+  std::string header = ".i " + std::to_string(bits.size()) + "\n.o " + std::to_string(outputs) + "\n.ilb";
+  for (auto b : bits) {
+    header += " a" + std::to_string(b);
+  }
+  // A bitwise table is named after its output bit
+  header += "\n.ob";
+  for (uint64_t o = 0; o < outputs; o++) {
+    header += (encoding == PLA_ONE_HOT ? " c" : " h") + std::to_string(encoding == PLA_SINGLE ? bit : o);
+  }
+  header += "\n.type fdr\n";
+  this->writer.reset(new RingWriter<pla_record>(path, header, format_pla_record, ".e\n"));
+}
+
+void PlaWriter::push(const dump_record& record) {
+  bool care = record.mapped && record.margin >= this->min_margin;
+  this->writer->push(pla_record{idx_from_idx_vec_and_addr(this->bits, record.addr), record.value,
+                                (uint8_t)this->bits.size(), this->outputs, (uint8_t)this->encoding, care});
+}
+
+/*
+ * The PLA is written next to the dump, with the extension replaced
+ */
+DumpWriter::DumpWriter(std::string path, const pla_spec& spec, const std::vector<uint64_t>& bits, int64_t bit,
+                       uint64_t classes)
+    : csv(path, DUMP_HEADER, format_dump_record) {
+  if (!spec.enabled) {
+    return;
+  }
+  auto pla_path = path.substr(0, path.rfind('.')) + PLA_EXTENSION;
+  auto encoding = bit >= 0 ? PLA_SINGLE : spec.binary ? PLA_BINARY : PLA_ONE_HOT;
+  this->pla.reset(new PlaWriter(pla_path, bits, encoding, classes, spec.min_margin, bit >= 0 ? bit : 0));
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <plog/Log.h>
+
+#include "../include/progress.hpp"
+#include "../include/metrics.hpp"
+#include "../include/housekeeping.hpp"
+
+std::atomic<uint64_t> Progress::done{0};
+std::atomic<uint64_t> Progress::run_total{0};
+std::atomic<uint64_t> Progress::table_start{0};
+std::atomic<uint64_t> Progress::table_total{0};
+std::atomic<int> Progress::table_bit{-1};
+
+/*
+ * Announces the number of entries of all tables that will be dumped
+ */
+void Progress::begin_run(uint64_t entries) {
+  run_total.store(done.load() + entries);
+}
+
+/*
+ * Announces a new table, entries of the previous one count as done
+ */
+void Progress::begin_table(int bit, uint64_t entries) {
+  table_bit.store(bit);
+  table_total.store(entries);
+  table_start.store(done.load());
+}
+
+/*
+ * Formats seconds as h:mm:ss
+ */
+static std::string format_duration(double seconds) {
+  if (seconds < 0 || seconds > 1e9) {
+    return "?";
+  }
+  char buff[32];
+  uint64_t s = seconds;
+  snprintf(buff, sizeof(buff), "%lu:%02lu:%02lu", s / 3600, (s / 60) % 60, s % 60);
+  return buff;
+}
+
+ProgressReporter::ProgressReporter(unsigned interval) {
+  this->interval = interval;
+  this->stopped = false;
+  this->thread = std::thread(&ProgressReporter::run, this);
+}
+
+ProgressReporter::~ProgressReporter() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopped = true;
+  }
+  this->wakeup.notify_all();
+  this->thread.join();
+}
+
+void ProgressReporter::run() {
+  Housekeeping::pin();
+  auto last_time = std::chrono::steady_clock::now();
+  uint64_t last_done = Progress::done.load();
+  uint64_t last_calls = Metrics::total(COUNTER_ORACLE_CALLS);
+  uint64_t last_decisions = Metrics::total(COUNTER_DECISIONS);
+  uint64_t last_retries = Metrics::total(COUNTER_RETRIES);
+  double ewma_rate = 0;
+
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (!this->stopped) {
+    if (this->wakeup.wait_for(guard, std::chrono::seconds(this->interval), [this] { return this->stopped; })) {
+      break;
+    }
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - last_time).count();
+    uint64_t done = Progress::done.load();
+    uint64_t calls = Metrics::total(COUNTER_ORACLE_CALLS);
+    uint64_t decisions = Metrics::total(COUNTER_DECISIONS);
+    uint64_t retries = Metrics::total(COUNTER_RETRIES);
+
+    double rate = (done - last_done) / dt;
+    double call_rate = (calls - last_calls) / dt;
+    double remeasure_rate = decisions > last_decisions ? (double)(retries - last_retries) / (decisions - last_decisions) : 0;
+    ewma_rate = ewma_rate == 0 ? rate : PROGRESS_EWMA_ALPHA * rate + (1 - PROGRESS_EWMA_ALPHA) * ewma_rate;
+
+    last_time = now;
+    last_done = done;
+    last_calls = calls;
+    last_decisions = decisions;
+    last_retries = retries;
+
+    uint64_t table_done = done - Progress::table_start.load();
+    uint64_t table_total = Progress::table_total.load();
+    uint64_t run_total = Progress::run_total.load();
+    if (!table_total) {
+      PLOG_INFO << "Progress: " << call_rate << " oracle calls/s, " << remeasure_rate * 100 << "% remeasures";
+      continue;
+    }
+    uint64_t table_left = table_total > table_done ? table_total - table_done : 0;
+    uint64_t run_left = run_total > done ? run_total - done : 0;
+    int bit = Progress::table_bit.load();
+    PLOG_INFO << "Progress " << (bit < 0 ? std::string("h") : "h[" + std::to_string(bit) + "]") << ": "
+              << table_done << "/" << table_total << " (" << (table_done * 100.0 / table_total) << "%), " << rate
+              << " entries/s, " << call_rate << " oracle calls/s, " << remeasure_rate * 100 << "% remeasures, ETA "
+              << format_duration(table_left / ewma_rate) << ", run ETA " << format_duration(run_left / ewma_rate);
+  }
+}
@@ -0,0 +1,133 @@
+#include <iterator>
+#include <plog/Log.h>
+
+#include "../include/addr.hpp"
+
+/*
+ * Returns the mappable ranges
+ */
+const dram_ctx& RangeAddr::get_dram() const{
+    return this->dram;
+}
+
+/*
+ * Checks if the address maps to a valid dram range
+ */
+bool RangeAddr::valid_address(pointer addr){
+    return this->dram.ram_ranges.find(addr) != this->dram.ram_ranges.end();
+}
+
+
+/*
+ * Returns a random physical address
+ * This can potentially be optimized by directky returning a valid address from one of the intervals
+ */
+pointer RangeAddr::get_random_addr(){
+    // Select address smaller than max dram range
+    int range_select = this->rnd(this->dram.ram_ranges.iterative_size());
+    auto range_it = *std::next(this->dram.ram_ranges.begin(), range_select);
+    auto range_delta = range_it.upper()-range_it.lower();
+    int low = contains(range_it, lower(range_it)) ? 0 : 1;
+    int up = contains(range_it, upper(range_it)) ? 0 : 1;
+    pointer addr = (range_it.lower() + low) + (this->rnd(range_delta-up));
+   
+    if(!valid_address(addr)){
+        PLOG_FATAL << "Invalid physical address selected: " << range_select << " " << range_it << " " << addr << " " << (addr&0x11111) << " " << range_delta << "\n";
+        exit(1);
+    }
+    return addr;
+}
+
+
+/*
+* Advances the bitmask iterator returning an address
+*/
+std::pair<pointer,bool> RangeAddr::advance_bitmask_iterator(size_t step) {
+
+  auto addr=this->bitmsask_iterator_position;
+
+  auto addr_max_bm = this->bitmsask_iterator_position | this->bitmask_invert;
+  auto bitmask_range = boost::icl::discrete_interval<pointer>::closed(addr, addr_max_bm);
+  if(!boost::icl::intersects(this->dram.ram_ranges, bitmask_range)){
+    this->bitmsask_iterator_position = this->next_iterator_position(step);
+    //PLOG_ERROR << "Address [" << std::hex << this->bitmsask_iterator_position << std::dec <<"] cannot be mapped";
+    return std::make_pair(addr,false);
+  }
+
+  if(!valid_address(addr)){
+    addr = redraw(addr);
+  }
+  follow_node(addr);
+
+  // increment bitmask
+  this->bitmsask_iterator_position = this->next_iterator_position(step);
+  // Return found address
+  return std::make_pair(addr,true);
+}
+
+/*
+* Flips the bits outside the iterated ones until the address is mappable. With
+* nodes to keep, addresses on the node of the previous one are tried first so
+* that the measurement does not move between nodes for every entry.
+*/
+pointer RangeAddr::redraw(pointer addr){
+  pointer addr_new;
+  if(!this->redraw_nodes.empty()){
+    auto& ranges = this->redraw_nodes[this->redraw_node].ram_ranges;
+    for (size_t t = 0; t < ADDR_NODE_REDRAWS; t++)
+    {
+      addr_new = flip_unused_bits(addr);
+      if(ranges.find(addr_new) != ranges.end()){
+        return addr_new;
+      }
+    }
+  }
+  do{
+    addr_new = flip_unused_bits(addr);
+  }while(!valid_address(addr_new));
+  PLOG_VERBOSE << "Flipping physical address bits from " << std::hex << addr << std::dec << " to " << std::hex << addr_new << std::dec;
+  return addr_new;
+}
+
+/*
+* Remembers the node of an address that is measured next for later redraws
+*/
+void RangeAddr::follow_node(pointer addr){
+  if(this->redraw_nodes.empty()){
+    return;
+  }
+  auto& ranges = this->redraw_nodes[this->redraw_node].ram_ranges;
+  if(ranges.find(addr) != ranges.end()){
+    return;
+  }
+  for (size_t n = 0; n < this->redraw_nodes.size(); n++)
+  {
+    if(this->redraw_nodes[n].ram_ranges.find(addr) != this->redraw_nodes[n].ram_ranges.end()){
+      this->redraw_node = n;
+      return;
+    }
+  }
+}
+
+pointer RangeAddr::get_alternative_addr(pointer addr){
+  addr = redraw(addr);
+  follow_node(addr);
+  return addr;
+}
+
+/*
+* Redraws of the iterator and alternative addresses prefer the node of the
+* previous address
+*/
+void RangeAddr::keep_nodes(const std::vector<numa_node>& nodes){
+  this->redraw_nodes = nodes;
+  this->redraw_node = 0;
+}
+
+/*
+* Flips bit no in the bitmask iterator to get a usable address
+*/
+pointer RangeAddr::flip_unused_bits(pointer addr){
+  auto rand_mask = (this->rnd() & ~this->bitmask) & (((uint64_t) 1 << this->maxbits) - 1);
+  return rand_mask ^ addr;
+}
@@ -0,0 +1,68 @@
+#include <fstream>
+#include <stdexcept>
+
+#include "../include/shard.hpp"
+
+/*
+ * Parses i/N
+ */
+shard_spec parse_shard(std::string spec) {
+  auto slash = spec.find('/');
+  if (slash == std::string::npos) {
+    std::throw_with_nested(std::runtime_error("Shard " + spec + " is not of the form i/N"));
+  }
+  shard_spec parsed{std::stoull(spec.substr(0, slash)), std::stoull(spec.substr(slash + 1))};
+  if (parsed.shards == 0 || parsed.shard >= parsed.shards) {
+    std::throw_with_nested(std::runtime_error("Shard " + spec + " needs 0 <= i < N"));
+  }
+  return parsed;
+}
+
+/*
+ * First and one past the last entry index of a table that the shard measures
+ */
+std::pair<uint64_t, uint64_t> shard_range(uint64_t entries, shard_spec spec) {
+  return {(unsigned __int128)entries * spec.shard / spec.shards,
+          (unsigned __int128)entries * (spec.shard + 1) / spec.shards};
+}
+
+/*
+ * Entry indices spread over the whole table, the same for every shard
+ */
+std::vector<uint64_t> shard_anchors(uint64_t entries) {
+  std::vector<uint64_t> anchors;
+  uint64_t stride = entries > SHARD_ANCHORS ? entries / SHARD_ANCHORS : 1;
+  for (uint64_t x = 0; x < entries && anchors.size() < SHARD_ANCHORS; x += stride) {
+    anchors.push_back(x);
+  }
+  return anchors;
+}
+
+void write_shard_file(std::string output_dir, shard_spec spec) {
+  std::ofstream file(output_dir + "/" SHARD_FILE);
+  file << "shard,shards,classes\n" << spec.shard << "," << spec.shards << "," << spec.classes << "\n";
+}
+
+/*
+ * Output directories without a shard file hold a complete dump, shard files
+ * without a class count leave it unknown
+ */
+shard_spec read_shard_file(std::string output_dir) {
+  std::ifstream file(output_dir + "/" SHARD_FILE);
+  if (!file.is_open()) {
+    return shard_spec{0, 1};
+  }
+  std::string line;
+  std::getline(file, line);
+  std::getline(file, line);
+  auto comma = line.find(',');
+  if (comma == std::string::npos) {
+    std::throw_with_nested(std::runtime_error(output_dir + "/" SHARD_FILE " is malformed"));
+  }
+  shard_spec spec{std::stoull(line.substr(0, comma)), std::stoull(line.substr(comma + 1))};
+  auto classes = line.find(',', comma + 1);
+  if (classes != std::string::npos) {
+    spec.classes = std::stoull(line.substr(classes + 1));
+  }
+  return spec;
+}
@@ -0,0 +1,66 @@
+#include <plog/Log.h>
+
+#include "../include/addr.hpp"
+
+/*
+ * Builds a dram context from the mappable ranges
+ */
+dram_ctx get_ranges_dram_ctx(boost::icl::interval_set<pointer> ram_ranges) {
+  uint64_t ram_addresses = 0;
+  for (auto range : ram_ranges) {
+    ram_addresses += range.upper() - range.lower();
+  }
+
+  uint64_t max_addr = 0;
+  for (auto range : ram_ranges) {
+    max_addr = std::max(max_addr, range.upper());
+  }
+  return dram_ctx{ram_ranges, ram_addresses, max_addr};
+}
+
+/*
+ * Builds a synthetic dram context covering maxbits of physical addresses
+ * minus the given holes
+ */
+static dram_ctx get_sim_dram_ctx(size_t maxbits, boost::icl::interval_set<pointer> holes) {
+  boost::icl::interval_set<pointer> ram_ranges;
+  ram_ranges += boost::icl::discrete_interval<pointer>::closed(0, (1ULL << maxbits) - 1);
+  return get_ranges_dram_ctx(ram_ranges - holes);
+}
+
+/*
+ * Init a simulated address space, no memory is mapped
+ */
+SimAddr::SimAddr(size_t maxbits, boost::icl::interval_set<pointer> holes) {
+  this->dram = get_sim_dram_ctx(maxbits, holes);
+  this->maxbits = maxbits;
+
+  for (auto range : this->dram.ram_ranges) {
+    PLOG_DEBUG << std::hex << range << std::dec << ": " << (range.upper() - range.lower()) << "b";
+  }
+  PLOG_INFO << this->maxbits << " bits of simulated memory, "
+            << (((float)((1ULL << maxbits) - this->dram.ram_addresses) / (float)(1ULL << maxbits)) * 100)
+            << "% in holes";
+}
+
+/*
+ * Init a simulated address space with the layout of another one, e.g. from a trace
+ */
+SimAddr::SimAddr(size_t maxbits, dram_ctx dram) {
+  this->dram = dram;
+  this->maxbits = maxbits;
+  PLOG_INFO << this->maxbits << " bits of simulated memory in " << dram.ram_ranges.iterative_size() << " ranges";
+}
+
+SimAddr::~SimAddr() {}
+
+/*
+ * Simulated addresses are never accessed, so the oracle gets the address itself
+ */
+pointer SimAddr::map_addr(pointer addr) {
+  return addr;
+}
+
+pointer SimAddr::unmap_addr(pointer mapped) {
+  return mapped;
+}
@@ -0,0 +1,109 @@
+#include <fcntl.h>
+#include <algorithm>
+#include <iostream>
+#include <plog/Log.h>
+
+#include "../include/threshold.hpp"
+#include "../include/metrics.hpp"
+#include "../include/utils.hpp"
+
+/*
+ * Starts with the Otsu threshold of the calibration samples
+ */
+StreamingThreshold::StreamingThreshold(const std::vector<uint64_t>& calibration, uint64_t window_size) {
+  this->threshold = ostsu_treshold(calibration);
+  this->bucket_width = std::max<uint64_t>(1, (4 * this->threshold + THRESHOLD_BUCKETS - 1) / THRESHOLD_BUCKETS);
+  this->window_size = std::max<uint64_t>(1, window_size);
+  this->window_samples = 0;
+  this->windows = 0;
+  this->window.assign(THRESHOLD_BUCKETS, 0);
+  this->cusum_up = 0;
+  this->cusum_down = 0;
+  this->drifted = false;
+}
+
+/*
+ * Otsu threshold of a histogram, samples below the returned threshold are
+ * fast. Returns false if the histogram does not split into two well
+ * separated classes.
+ */
+bool StreamingThreshold::estimate(const std::vector<uint64_t>& hist, uint64_t& threshold) const {
+  double total = 0;
+  double sum = 0;
+  double sum_sq = 0;
+  for (size_t i = 0; i < hist.size(); i++) {
+    total += hist[i];
+    sum += (double)i * hist[i];
+    sum_sq += (double)i * i * hist[i];
+  }
+  if (total == 0) {
+    return false;
+  }
+  double var_total = sum_sq / total - (sum / total) * (sum / total);
+  if (var_total <= 0) {
+    return false;
+  }
+
+  double q1 = 0;
+  double sum_b = 0;
+  double var_max = 0;
+  size_t split = 0;
+  for (size_t i = 0; i < hist.size(); i++) {
+    q1 += hist[i];
+    sum_b += (double)i * hist[i];
+    double q2 = total - q1;
+    if (q1 == 0) {
+      continue;
+    }
+    if (q2 == 0) {
+      break;
+    }
+    double m1 = sum_b / q1;
+    double m2 = (sum - sum_b) / q2;
+    double var_between = (q1 / total) * (q2 / total) * (m1 - m2) * (m1 - m2);
+    if (var_between > var_max) {
+      var_max = var_between;
+      split = i;
+    }
+  }
+
+  // The fast class ends with the split bucket
+  double fast = 0;
+  for (size_t i = 0; i <= split; i++) {
+    fast += hist[i];
+  }
+  threshold = (split + 1) * this->bucket_width;
+  return var_max / var_total >= THRESHOLD_MIN_SEPARATION && fast / total >= THRESHOLD_MIN_CLASS &&
+         (total - fast) / total >= THRESHOLD_MIN_CLASS;
+}
+
+/*
+ * Tests the estimate of the finished window against the threshold in use and
+ * switches to the recent timings if they drifted away
+ */
+void StreamingThreshold::end_window() {
+  uint64_t window_threshold;
+  bool separated = estimate(this->window, window_threshold);
+  this->windows++;
+
+  if (separated && this->drifted) {
+    PLOG_INFO << "Recalibrated threshold after timing drift, " << this->threshold << " -> " << window_threshold;
+    this->threshold = window_threshold;
+    this->drifted = false;
+    Metrics::add(COUNTER_RECALIBRATIONS);
+  } else if (separated) {
+    double deviation = ((double)window_threshold - (double)this->threshold) / (double)this->threshold;
+    this->cusum_up = std::max(0.0, this->cusum_up + deviation - THRESHOLD_CUSUM_SLACK);
+    this->cusum_down = std::max(0.0, this->cusum_down - deviation - THRESHOLD_CUSUM_SLACK);
+    if (this->cusum_up > THRESHOLD_CUSUM_LIMIT || this->cusum_down > THRESHOLD_CUSUM_LIMIT) {
+      PLOG_INFO << "Timing drift detected after " << this->windows << " windows, estimate " << window_threshold
+                << " instead of " << this->threshold;
+      this->drifted = true;
+      this->cusum_up = 0;
+      this->cusum_down = 0;
+    }
+  }
+
+  std::fill(this->window.begin(), this->window.end(), 0);
+  this->window_samples = 0;
+}
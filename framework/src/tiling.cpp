@@ -0,0 +1,41 @@
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/tiling.hpp"
+#include "../include/utils.hpp"
+
+/*
+ * Deposits the bits of tile into the fixed address bits
+ */
+pointer tile_assignment(const std::vector<uint64_t>& fixed_bits, uint64_t tile) {
+  return addr_from_idx_vec_and_idx(fixed_bits, tile);
+}
+
+TileManifest::TileManifest(std::string output_dir) {
+  this->output_dir = output_dir;
+  std::filesystem::create_directories(output_dir + "/" TILING_DIR);
+  this->file.open(output_dir + "/" TILING_MANIFEST);
+  if (!this->file.is_open()) {
+    std::throw_with_nested(std::runtime_error(output_dir + "/" TILING_MANIFEST " could not be opened"));
+  }
+  this->file << "bit,tile,fixed_mask,fixed_value,file\n";
+}
+
+/*
+ * Records a tile and returns the path its table is written to, bit is -1 for
+ * the table of all output bits
+ */
+std::string TileManifest::add(int64_t bit, uint64_t tile, const std::vector<uint64_t>& fixed_bits) {
+  char name[100];
+  if (bit < 0) {
+    snprintf(name, sizeof(name), TILING_DIR "/allbits_tile_%ld.csv", tile);
+  } else {
+    snprintf(name, sizeof(name), TILING_DIR "/bit_%ld_tile_%ld.csv", bit, tile);
+  }
+  this->file << bit << "," << tile << ",0x" << std::hex << tile_assignment(fixed_bits, ~0ULL) << ",0x"
+             << tile_assignment(fixed_bits, tile) << std::dec << "," << name << "\n";
+  this->file.flush();
+  return this->output_dir + "/" + name;
+}
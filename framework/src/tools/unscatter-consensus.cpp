@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "CLI/App.hpp"
+#include "CLI/Formatter.hpp"
+#include "CLI/Config.hpp"
+
+#include "../../include/truth-table.hpp"
+#include "../../include/consensus.hpp"
+#include "../../include/tiling.hpp"
+
+#define DISPUTED_FILE "disputed.csv" // entries to remeasure, below the output directory
+
+/*
+ * Votes on every entry of every table of several dumps of the same function
+ */
+static void consensus(const std::vector<std::string>& dirs, std::vector<unsigned> weights, double dispute,
+                      std::string output_dir) {
+  if (weights.empty()) {
+    weights.assign(dirs.size(), 1);
+  }
+  if (weights.size() != dirs.size()) {
+    std::throw_with_nested(std::runtime_error("Give one weight per run or none"));
+  }
+
+  auto bits = read_bits_file(dirs[0] + "/bits.csv");
+  for (auto& dir : dirs) {
+    if (read_bits_file(dir + "/bits.csv") != bits) {
+      std::throw_with_nested(std::runtime_error(dir + " has different relevant bits than " + dirs[0]));
+    }
+  }
+  auto tables = list_dump_tables(dirs[0], bits);
+  PLOG_INFO << "Voting on " << tables.size() << " tables of " << dirs.size() << " runs";
+
+  std::filesystem::create_directories(output_dir);
+  write_bits_file(output_dir + "/bits.csv", bits);
+  if (std::filesystem::exists(dirs[0] + "/" TILING_MANIFEST)) {
+    std::filesystem::create_directories(output_dir + "/" TILING_DIR);
+    std::filesystem::copy_file(dirs[0] + "/" TILING_MANIFEST, output_dir + "/" TILING_MANIFEST);
+  }
+  std::ofstream disputed_file(output_dir + "/" DISPUTED_FILE);
+  disputed_file << "table,addr,class,agree,total\n";
+
+  for (auto& table_file : tables) {
+    std::vector<truth_table> runs;
+    for (auto& dir : dirs) {
+      runs.push_back(read_truth_table(dir + "/" + table_file.file, table_file.bits));
+      if (table_file.naive && runs.size() > 1) {
+        align_run_labels(runs[0], runs.back());
+      }
+    }
+    truth_table out;
+    std::vector<disputed_entry> disputed;
+    auto stats = table_file.naive ? consensus_classes(runs, weights, dispute, out, disputed)
+                                  : consensus_bitwise(runs, weights, dispute, out, disputed);
+    write_dump(output_dir + "/" + table_file.file, out);
+    for (auto& entry : disputed) {
+      disputed_file << table_file.file << "," << out.addrs[entry.index] << "," << entry.value << "," << entry.agree
+                    << "," << entry.total << "\n";
+    }
+    PLOG_INFO << table_file.file << ": " << stats.unanimous << " unanimous, " << stats.contested << " contested, "
+              << stats.disputed << " disputed, " << stats.unvoted << " without votes";
+  }
+}
+
+int main(int argc, char** argv) {
+  CLI::App app{"Merges several noisy dumps of the same function by weighted majority vote."};
+
+  std::vector<std::string> dirs;
+  app.add_option("runs", dirs, "Output directories of the runs")->required();
+
+  std::vector<unsigned> weights;
+  app.add_option("-w,--weight", weights, "Weight of each run, in the order of the runs (1 if not given)");
+
+  double dispute = CONSENSUS_DISPUTE;
+  app.add_option("-d,--dispute", dispute, "Entries whose losing votes hold at least this share of the weight are listed in disputed.csv");
+
+  std::string output_dir = "measurements";
+  app.add_option("-o,--output-dir", output_dir, "Directory for the consensus tables");
+
+  CLI11_PARSE(app, argc, argv);
+
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::debug, &consoleAppender);
+
+  if (std::filesystem::exists(output_dir)) {
+    PLOG_FATAL << output_dir << " exists, delete it to vote again";
+    exit(1);
+  }
+  try {
+    consensus(dirs, weights, dispute, output_dir);
+  } catch (const std::exception& e) {
+    PLOG_FATAL << e.what();
+    exit(1);
+  }
+}
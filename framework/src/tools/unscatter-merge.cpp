@@ -0,0 +1,184 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "CLI/App.hpp"
+#include "CLI/Formatter.hpp"
+#include "CLI/Config.hpp"
+
+#include "../../include/truth-table.hpp"
+#include "../../include/shard.hpp"
+#include "../../include/tiling.hpp"
+
+static std::string read_file(std::string path) {
+  std::ifstream file(path);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/*
+ * Maps the class labels of a shard to the labels of shard 0 using the anchor
+ * entries both measured
+ */
+static std::map<uint64_t, uint64_t> align_labels(std::string path, const std::vector<dump_entry>& reference,
+                                                 const std::vector<dump_entry>& anchors) {
+  std::map<uint64_t, uint64_t> reference_labels, labels;
+  for (auto& entry : reference) {
+    reference_labels[entry.index] = entry.value;
+  }
+  for (auto& entry : anchors) {
+    auto ref = reference_labels.find(entry.index);
+    if (ref == reference_labels.end()) {
+      continue;
+    }
+    auto label = labels.find(entry.value);
+    if (label != labels.end() && label->second != ref->second) {
+      std::throw_with_nested(std::runtime_error(path + ": class " + std::to_string(entry.value) + " matches classes " +
+                                                std::to_string(label->second) + " and " + std::to_string(ref->second) +
+                                                " of shard 0, the class labelling is inconsistent"));
+    }
+    labels[entry.value] = ref->second;
+  }
+  return labels;
+}
+
+/*
+ * Assembles the tables of all shards, every entry has to be measured by
+ * exactly the shard whose range it lies in
+ */
+static void merge(const std::vector<std::string>& dirs, std::string output_dir) {
+  // Shards have to be complete, belong to the same split and see the same classes
+  std::vector<std::string> shard_dirs(read_shard_file(dirs[0]).shards);
+  std::string classes_dir; // first shard with a known class count
+  uint64_t classes = 0;
+  for (auto& dir : dirs) {
+    auto spec = read_shard_file(dir);
+    if (spec.classes && classes && spec.classes != classes) {
+      std::throw_with_nested(std::runtime_error(dir + " was measured with " + std::to_string(spec.classes) +
+                                                " output classes, " + classes_dir + " with " +
+                                                std::to_string(classes)));
+    }
+    if (spec.classes && !classes) {
+      classes = spec.classes;
+      classes_dir = dir;
+    }
+    if (spec.shards != shard_dirs.size()) {
+      std::throw_with_nested(std::runtime_error(dir + " is shard " + std::to_string(spec.shard) + "/" +
+                                                std::to_string(spec.shards) + ", expected " +
+                                                std::to_string(shard_dirs.size()) + " shards"));
+    }
+    if (shard_dirs[spec.shard] != "") {
+      std::throw_with_nested(std::runtime_error(dir + " and " + shard_dirs[spec.shard] + " are both shard " +
+                                                std::to_string(spec.shard)));
+    }
+    shard_dirs[spec.shard] = dir;
+  }
+  for (size_t shard = 0; shard < shard_dirs.size(); shard++) {
+    if (shard_dirs[shard] == "") {
+      std::throw_with_nested(std::runtime_error("Shard " + std::to_string(shard) + " is missing"));
+    }
+  }
+
+  // Relevant bits and tiles have to be the same for all shards
+  auto bits_file = read_file(shard_dirs[0] + "/bits.csv");
+  auto manifest_file = read_file(shard_dirs[0] + "/" TILING_MANIFEST);
+  for (auto& dir : shard_dirs) {
+    if (read_file(dir + "/bits.csv") != bits_file || read_file(dir + "/" TILING_MANIFEST) != manifest_file) {
+      std::throw_with_nested(std::runtime_error(dir + " has different relevant bits or tiles than " + shard_dirs[0]));
+    }
+  }
+  auto bits = read_bits_file(shard_dirs[0] + "/bits.csv");
+  auto tables = list_dump_tables(shard_dirs[0], bits);
+  PLOG_INFO << "Merging " << tables.size() << " tables from " << shard_dirs.size() << " shards";
+
+  std::filesystem::create_directories(output_dir + "/" TILING_DIR);
+  write_bits_file(output_dir + "/bits.csv", bits);
+  if (manifest_file != "") {
+    std::ofstream(output_dir + "/" TILING_MANIFEST) << manifest_file;
+  }
+
+  for (auto& table_file : tables) {
+    auto table = make_truth_table(table_file.bits);
+    auto anchor_file = table_file.file.substr(0, table_file.file.size() - 4) + ".anchors.csv";
+    std::vector<dump_entry> reference;
+    if (table_file.naive && shard_dirs.size() > 1) {
+      reference = read_dump(shard_dirs[0] + "/" + anchor_file, table_file.bits);
+    }
+    for (size_t shard = 0; shard < shard_dirs.size(); shard++) {
+      auto path = shard_dirs[shard] + "/" + table_file.file;
+      auto range = shard_range(table.state.size(), shard_spec{shard, shard_dirs.size()});
+      std::map<uint64_t, uint64_t> labels;
+      if (!reference.empty()) {
+        labels = align_labels(path, reference, read_dump(shard_dirs[shard] + "/" + anchor_file, table_file.bits));
+      }
+      for_each_dump_entry(path, table_file.bits, [&](const dump_entry& entry) {
+        if (entry.index < range.first || entry.index >= range.second) {
+          std::throw_with_nested(std::runtime_error(path + ": entry " + std::to_string(entry.index) +
+                                                    " is outside of the shard"));
+        }
+        if (table.state[entry.index] != ENTRY_MISSING) {
+          std::throw_with_nested(std::runtime_error(path + ": entry " + std::to_string(entry.index) + " is duplicated"));
+        }
+        auto value = entry.value;
+        if (entry.mapped && !table_file.naive && value > 1) {
+          std::throw_with_nested(std::runtime_error(path + ": class " + std::to_string(value) + " in a bitwise table"));
+        }
+        if (entry.mapped && !reference.empty()) {
+          auto label = labels.find(value);
+          if (label == labels.end()) {
+            std::throw_with_nested(std::runtime_error(path + ": class " + std::to_string(value) +
+                                                      " was not seen on an anchor entry, it cannot be aligned"));
+          }
+          value = label->second;
+        }
+        table.addrs[entry.index] = entry.addr;
+        table.values[entry.index] = value;
+        table.margins[entry.index] = entry.margin;
+        table.state[entry.index] = entry.mapped ? ENTRY_KNOWN : ENTRY_UNMAPPED;
+      });
+    }
+    auto missing = std::count(table.state.begin(), table.state.end(), ENTRY_MISSING);
+    if (missing) {
+      std::throw_with_nested(std::runtime_error(table_file.file + ": " + std::to_string(missing) + " of " +
+                                                std::to_string(table.state.size()) + " entries are missing"));
+    }
+    write_dump(output_dir + "/" + table_file.file, table);
+    PLOG_INFO << table_file.file << ": " << table.state.size() << " entries";
+  }
+  if (manifest_file == "") {
+    std::filesystem::remove(output_dir + "/" TILING_DIR);
+  }
+}
+
+int main(int argc, char** argv) {
+  CLI::App app{"Merges the shards of an unscatter dump."};
+
+  std::vector<std::string> dirs;
+  app.add_option("shards", dirs, "Output directories of all shards")->required();
+
+  std::string output_dir = "measurements";
+  app.add_option("-o,--output-dir", output_dir, "Directory for the merged tables");
+
+  CLI11_PARSE(app, argc, argv);
+
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::debug, &consoleAppender);
+
+  if (std::filesystem::exists(output_dir)) {
+    PLOG_FATAL << output_dir << " exists, delete it to merge again";
+    exit(1);
+  }
+  try {
+    merge(dirs, output_dir);
+  } catch (const std::exception& e) {
+    PLOG_FATAL << e.what();
+    exit(1);
+  }
+}
@@ -0,0 +1,255 @@
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "CLI/App.hpp"
+#include "CLI/Formatter.hpp"
+#include "CLI/Config.hpp"
+
+#include "../../include/truth-table.hpp"
+
+#define MINIMIZE_SUMMARY "minimize.csv" // one line per job, below the dump directory
+#define MINIMIZE_POLL_MS 100 // interval in which running jobs are checked
+#define MINIMIZE_EXIT_EXEC 127 // exit code of a job whose minimizer could not be started
+
+/*
+ * One minimization of a table, fixed relevant bits are set to zero to make
+ * runaway tables smaller
+ */
+typedef struct minimize_job {
+  dump_table table;
+  size_t fixed; // highest relevant bits that are fixed to zero
+  std::string input; // espresso input below the dump directory
+  pid_t pid;
+  std::chrono::steady_clock::time_point start;
+  bool timed_out;
+} minimize_job;
+
+/*
+ * Settings shared by all jobs
+ */
+typedef struct minimize_spec {
+  std::string dir;
+  std::string python;
+  std::string minimizer;
+  uint32_t min_margin;
+  size_t time_limit; // seconds, 0 disables
+  size_t memory_limit; // MiB of address space per process, 0 disables
+  size_t fallback_bits; // bits fixed additionally by each fallback
+  size_t fallbacks;
+} minimize_spec;
+
+static std::string stem(const std::string& file) {
+  return file.substr(0, file.rfind('.'));
+}
+
+/*
+ * The minimizer writes its solution next to the input, named after the input
+ * up to the first dot
+ */
+static std::string solution_path(const std::string& input) {
+  auto slash = input.rfind('/');
+  auto dir = slash == std::string::npos ? std::string("") : input.substr(0, slash + 1);
+  auto name = input.substr(dir.size());
+  return dir + name.substr(0, name.find('.')) + ".sol";
+}
+
+/*
+ * Writes the espresso input of a table with the highest fixed relevant bits
+ * set to zero, tables without fixed bits use the PLA of the dump if there is
+ * one. Unmapped entries and entries below the minimum margin are don't cares.
+ */
+static std::string write_input(const minimize_spec& spec, const dump_table& table, size_t fixed) {
+  auto name = stem(table.file);
+  if (fixed == 0 && std::filesystem::exists(spec.dir + "/" + name + ".pla")) {
+    return name + ".pla";
+  }
+  auto input = name + (fixed ? "_fixed" + std::to_string(fixed) : std::string("")) + ".espresso.in";
+  auto truth = read_truth_table(spec.dir + "/" + table.file, table.bits);
+  size_t inputs = table.bits.size() - fixed;
+
+  std::ofstream file(spec.dir + "/" + input);
+  if (!file.is_open()) {
+    std::throw_with_nested(std::runtime_error(spec.dir + "/" + input + " could not be opened"));
+  }
+  file << ".i " << inputs << "\n.o 1\n.type fdr\n";
+  std::string cube(inputs, '0');
+  for (uint64_t x = 0; x < (1ULL << inputs); x++) {
+    if (truth.state[x] == ENTRY_MISSING) {
+      continue;
+    }
+    for (size_t i = 0; i < inputs; i++) {
+      cube[i] = '0' + ((x >> i) & 0x1);
+    }
+    bool care = truth.state[x] == ENTRY_KNOWN && truth.margins[x] >= spec.min_margin;
+    file << cube << " " << (care ? (char)('0' + (truth.values[x] & 0x1)) : '-') << "\n";
+  }
+  file << ".e\n";
+  return input;
+}
+
+/*
+ * Starts the minimizer on the input of a job in its own process group, so a
+ * timeout also ends espresso and sage
+ */
+static void start_job(const minimize_spec& spec, minimize_job& job) {
+  job.input = write_input(spec, job.table, job.fixed);
+  auto input = spec.dir + "/" + job.input;
+  auto log = spec.dir + "/" + stem(job.input) + ".log";
+  std::filesystem::remove(spec.dir + "/" + solution_path(job.input));
+
+  job.start = std::chrono::steady_clock::now();
+  job.timed_out = false;
+  job.pid = fork();
+  if (job.pid < 0) {
+    std::throw_with_nested(std::runtime_error("Minimizer process could not be started"));
+  }
+  if (job.pid == 0) {
+    setpgid(0, 0);
+    if (spec.memory_limit) {
+      rlimit limit{spec.memory_limit << 20, spec.memory_limit << 20};
+      setrlimit(RLIMIT_AS, &limit);
+    }
+    int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+    execlp(spec.python.c_str(), spec.python.c_str(), spec.minimizer.c_str(), input.c_str(), (char*)NULL);
+    _exit(MINIMIZE_EXIT_EXEC);
+  }
+  setpgid(job.pid, job.pid);
+  PLOG_INFO << job.table.file << ": minimizing " << job.table.bits.size() - job.fixed << " bits"
+            << (job.fixed ? ", " + std::to_string(job.fixed) + " fixed to zero" : "");
+}
+
+/*
+ * Minimizes all tables of a dump with a bounded number of concurrent jobs,
+ * tables that fail or run out of time are retried with more bits fixed
+ */
+static void minimize(const minimize_spec& spec, size_t workers, bool force) {
+  auto bits = read_bits_file(spec.dir + "/bits.csv");
+  std::deque<minimize_job> pending;
+  for (auto& table : list_dump_tables(spec.dir, bits)) {
+    if (table.naive) {
+      PLOG_WARNING << table.file << ": tables of all output bits are not minimized, dump them bitwise";
+      continue;
+    }
+    pending.push_back(minimize_job{table, 0, "", 0, {}, false});
+  }
+
+  std::ofstream summary(spec.dir + "/" MINIMIZE_SUMMARY);
+  summary << "table,inputs,fixed,status,exit_code,seconds,solution\n";
+  size_t solved = 0, failed = 0;
+  std::vector<minimize_job> running;
+  while (!pending.empty() || !running.empty()) {
+    while (running.size() < workers && !pending.empty()) {
+      auto job = pending.front();
+      pending.pop_front();
+      if (!force && job.fixed == 0 && std::filesystem::exists(spec.dir + "/" + solution_path(job.table.file))) {
+        PLOG_INFO << job.table.file << ": already solved, skipping";
+        summary << job.table.file << "," << job.table.bits.size() << ",0,done,0,0," << solution_path(job.table.file)
+                << "\n";
+        solved++;
+        continue;
+      }
+      start_job(spec, job);
+      running.push_back(job);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(MINIMIZE_POLL_MS));
+
+    for (size_t r = 0; r < running.size();) {
+      auto& job = running[r];
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.start).count();
+      if (spec.time_limit && seconds > spec.time_limit && !job.timed_out) {
+        kill(-job.pid, SIGKILL);
+        job.timed_out = true;
+      }
+      int status;
+      if (waitpid(job.pid, &status, WNOHANG) != job.pid) {
+        r++;
+        continue;
+      }
+      // Children of the minimizer may outlive it
+      kill(-job.pid, SIGKILL);
+
+      int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status);
+      auto solution = solution_path(job.input);
+      bool ok = exit_code == 0 && std::filesystem::exists(spec.dir + "/" + solution);
+      std::string result = ok ? "solved" : job.timed_out ? "timeout" : "failed";
+      summary << job.table.file << "," << job.table.bits.size() - job.fixed << "," << job.fixed << "," << result
+              << "," << exit_code << "," << (uint64_t)seconds << "," << (ok ? solution : "") << "\n";
+      summary.flush();
+
+      size_t fixed = job.fixed + spec.fallback_bits;
+      if (ok) {
+        PLOG_INFO << job.table.file << ": solved in " << (uint64_t)seconds << "s, " << solution;
+        solved++;
+      } else if (exit_code != MINIMIZE_EXIT_EXEC && spec.fallback_bits && fixed <= spec.fallbacks * spec.fallback_bits &&
+                 fixed < job.table.bits.size()) {
+        PLOG_WARNING << job.table.file << ": " << result << " after " << (uint64_t)seconds << "s, retrying with "
+                     << fixed << " bits fixed to zero";
+        pending.push_front(minimize_job{job.table, fixed, "", 0, {}, false});
+      } else {
+        PLOG_ERROR << job.table.file << ": " << result << " after " << (uint64_t)seconds << "s, see "
+                   << stem(job.input) << ".log";
+        failed++;
+      }
+      running.erase(running.begin() + r);
+    }
+  }
+  PLOG_INFO << solved << " tables solved, " << failed << " failed, see " << spec.dir << "/" MINIMIZE_SUMMARY;
+}
+
+int main(int argc, char** argv) {
+  CLI::App app{"Minimizes the tables of a dump in parallel."};
+
+  minimize_spec spec{"", "python3", "test.py", 0, 0, 0, 4, 2};
+  app.add_option("dir", spec.dir, "Output directory of the dump")->required();
+
+  size_t workers = std::thread::hardware_concurrency();
+  app.add_option("-j,--jobs", workers, "Tables minimized at the same time (number of cores if not given)");
+
+  app.add_option("--python", spec.python, "Python interpreter with sage, runs the minimizer");
+  app.add_option("--minimizer", spec.minimizer, "Minimizer script, ../minimizer/test.py, it calls $ESPRESSO_EXECUTABLE");
+  app.add_option("--min-margin", spec.min_margin, "Entries with a vote margin below this are don't cares");
+  app.add_option("--time-limit", spec.time_limit, "Seconds a job may run before it is killed (0 disables)");
+  app.add_option("--memory-limit", spec.memory_limit, "MiB of address space of every process of a job (0 disables)");
+  app.add_option("--fallback-bits", spec.fallback_bits, "Highest relevant bits fixed to zero each time a job fails or times out");
+  app.add_option("--fallbacks", spec.fallbacks, "Number of retries with fixed bits");
+
+  bool force = false;
+  app.add_flag("--force", force, "Minimize tables that already have a solution again");
+
+  CLI11_PARSE(app, argc, argv);
+
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::debug, &consoleAppender);
+
+  if (workers == 0) {
+    workers = 1;
+  }
+  try {
+    minimize(spec, workers, force);
+  } catch (const std::exception& e) {
+    PLOG_FATAL << e.what();
+    exit(1);
+  }
+}
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <plog/Log.h>
+#include <plog/Init.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+
+#include "CLI/App.hpp"
+#include "CLI/Formatter.hpp"
+#include "CLI/Config.hpp"
+
+#include "../../include/truth-table.hpp"
+
+#define SPECTRUM_SUMMARY "spectrum.csv" // one line per table, below the dump directory
+#define SPECTRUM_INFLUENCE "influence.csv" // one line per relevant bit of every table
+#define SPECTRUM_WORD_BITS 6 // variables within one word of a packed table
+#define SPECTRUM_BLOCK (1ULL << 14) // coefficients transformed together while they are in cache
+#define SPECTRUM_MAX_INPUTS 30 // coefficients are 32 bit sums of +-1
+
+/*
+ * Table of one output bit with one bit per entry, entry x is bit x % 64 of
+ * word x / 64
+ */
+typedef struct packed_table {
+  size_t inputs;
+  std::vector<uint64_t> values;
+  std::vector<uint64_t> known; // measured entries with at least the minimum margin
+} packed_table;
+
+/*
+ * Largest Walsh coefficient, the table agrees with mask . x ^ constant on
+ * (known + |coefficient|) / 2 entries
+ */
+typedef struct affine_fit {
+  uint64_t mask; // relevant bits of the table, not address bits
+  int64_t coefficient;
+} affine_fit;
+
+static packed_table read_packed_table(const std::string& path, const std::vector<uint64_t>& bits,
+                                      uint32_t min_margin) {
+  size_t words = ((1ULL << bits.size()) + 63) / 64;
+  packed_table table{bits.size(), std::vector<uint64_t>(words, 0), std::vector<uint64_t>(words, 0)};
+  for_each_dump_entry(path, bits, [&](const dump_entry& entry) {
+    uint64_t bit = 1ULL << (entry.index % 64);
+    auto& value = table.values[entry.index / 64];
+    auto& known = table.known[entry.index / 64];
+    value = (value & ~bit) | ((entry.value & 0x1) ? bit : 0);
+    known = (entry.mapped && entry.margin >= min_margin) ? known | bit : known & ~bit;
+  });
+  return table;
+}
+
+/*
+ * In place Walsh-Hadamard transform of a power of two sized array. All
+ * butterflies of a block are done while it is in cache, only the strides
+ * across blocks pass over the whole array. The inner loops are vectorized,
+ * cloned for AVX2 and picked at load time.
+ */
+__attribute__((target_clones("avx2", "default"))) static void walsh_hadamard(int32_t* data, size_t size) {
+  size_t block = std::min<size_t>(size, SPECTRUM_BLOCK);
+  for (size_t start = 0; start < size; start += block) {
+    for (size_t h = 1; h < block; h <<= 1) {
+      for (size_t i = start; i < start + block; i += 2 * h) {
+        for (size_t j = i; j < i + h; j++) {
+          int32_t a = data[j], b = data[j + h];
+          data[j] = a + b;
+          data[j + h] = a - b;
+        }
+      }
+    }
+  }
+  for (size_t h = block; h < size; h <<= 1) {
+    for (size_t i = 0; i < size; i += 2 * h) {
+      for (size_t j = i; j < i + h; j++) {
+        int32_t a = data[j], b = data[j + h];
+        data[j] = a + b;
+        data[j + h] = a - b;
+      }
+    }
+  }
+}
+
+/*
+ * Finds the largest Walsh coefficient. The variables within a word are
+ * handled with one popcount per word and mask of them, every such mask is
+ * followed by a transform over the words. Masks are spread over the workers.
+ */
+static affine_fit best_affine(const packed_table& table, size_t workers) {
+  size_t low = std::min<size_t>(table.inputs, SPECTRUM_WORD_BITS);
+  size_t words = table.values.size();
+  uint64_t parity[1 << SPECTRUM_WORD_BITS];
+  for (uint64_t a = 0; a < (1ULL << low); a++) {
+    parity[a] = 0;
+    for (uint64_t x = 0; x < 64; x++) {
+      parity[a] |= (uint64_t)(__builtin_popcountll(a & x) & 0x1) << x;
+    }
+  }
+
+  std::atomic<uint64_t> next{0};
+  std::vector<affine_fit> fits(workers, affine_fit{0, 0});
+  auto work = [&](size_t worker) {
+    std::vector<int32_t> sums(words);
+    auto& fit = fits[worker];
+    for (uint64_t a = next++; a < (1ULL << low); a = next++) {
+      for (size_t w = 0; w < words; w++) {
+        uint64_t known = table.known[w];
+        sums[w] = __builtin_popcountll(known) - 2 * __builtin_popcountll(known & (table.values[w] ^ parity[a]));
+      }
+      walsh_hadamard(sums.data(), words);
+      for (size_t w = 0; w < words; w++) {
+        int64_t coefficient = sums[w];
+        uint64_t mask = (w << low) | a;
+        if (std::abs(coefficient) > std::abs(fit.coefficient) ||
+            (std::abs(coefficient) == std::abs(fit.coefficient) && mask < fit.mask)) {
+          fit = affine_fit{mask, coefficient};
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < workers; worker++) {
+    threads.push_back(std::thread(work, worker));
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto best = fits[0];
+  for (auto& fit : fits) {
+    if (std::abs(fit.coefficient) > std::abs(best.coefficient) ||
+        (std::abs(fit.coefficient) == std::abs(best.coefficient) && fit.mask < best.mask)) {
+      best = fit;
+    }
+  }
+  return best;
+}
+
+/*
+ * Counts the pairs of measured entries that differ only in variable i and
+ * those of them with different values
+ */
+static std::pair<uint64_t, uint64_t> influence(const packed_table& table, size_t i) {
+  // Entries of a word whose bit i is zero
+  static const uint64_t lower[SPECTRUM_WORD_BITS] = {0x5555555555555555ULL, 0x3333333333333333ULL,
+                                                     0x0f0f0f0f0f0f0f0fULL, 0x00ff00ff00ff00ffULL,
+                                                     0x0000ffff0000ffffULL, 0x00000000ffffffffULL};
+  uint64_t pairs = 0, differ = 0;
+  if (i < SPECTRUM_WORD_BITS) {
+    for (size_t w = 0; w < table.values.size(); w++) {
+      uint64_t both = table.known[w] & (table.known[w] >> (1 << i)) & lower[i];
+      pairs += __builtin_popcountll(both);
+      differ += __builtin_popcountll((table.values[w] ^ (table.values[w] >> (1 << i))) & both);
+    }
+    return {pairs, differ};
+  }
+  size_t stride = 1ULL << (i - SPECTRUM_WORD_BITS);
+  for (size_t w = 0; w < table.values.size(); w++) {
+    if (w & stride) {
+      continue;
+    }
+    uint64_t both = table.known[w] & table.known[w + stride];
+    pairs += __builtin_popcountll(both);
+    differ += __builtin_popcountll((table.values[w] ^ table.values[w + stride]) & both);
+  }
+  return {pairs, differ};
+}
+
+static std::string hex(uint64_t value) {
+  std::stringstream stream;
+  stream << "0x" << std::hex << value;
+  return stream.str();
+}
+
+/*
+ * Reports the best affine approximation and the influence of every relevant
+ * bit of all bitwise tables of a dump
+ */
+static void spectrum(std::string dir, uint32_t min_margin, double max_influence, size_t workers) {
+  auto bits = read_bits_file(dir + "/bits.csv");
+  std::ofstream summary(dir + "/" SPECTRUM_SUMMARY);
+  summary << "table,inputs,known,affine_mask,affine_constant,affine_errors,affine_error_rate,drop_bits\n";
+  std::ofstream influences(dir + "/" SPECTRUM_INFLUENCE);
+  influences << "table,bit,pairs,differ,influence,drop\n";
+
+  for (auto& entry : list_dump_tables(dir, bits)) {
+    if (entry.naive) {
+      PLOG_WARNING << entry.file << ": tables of all output bits have no spectrum, dump them bitwise";
+      continue;
+    }
+    if (entry.bits.size() > SPECTRUM_MAX_INPUTS) {
+      std::throw_with_nested(std::runtime_error(entry.file + ": " + std::to_string(entry.bits.size()) +
+                                                " relevant bits, at most " + std::to_string(SPECTRUM_MAX_INPUTS) +
+                                                " are supported"));
+    }
+    auto table = read_packed_table(dir + "/" + entry.file, entry.bits, min_margin);
+    uint64_t known = 0;
+    for (auto word : table.known) {
+      known += __builtin_popcountll(word);
+    }
+    if (known == 0) {
+      PLOG_WARNING << entry.file << ": no measured entries";
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto fit = best_affine(table, workers);
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t address_mask = 0;
+    for (size_t i = 0; i < entry.bits.size(); i++) {
+      address_mask |= ((fit.mask >> i) & 0x1) << entry.bits[i];
+    }
+    uint64_t errors = (known - std::abs(fit.coefficient)) / 2;
+
+    std::string drop;
+    for (size_t i = 0; i < entry.bits.size(); i++) {
+      auto counts = influence(table, i);
+      double share = counts.first ? (double)counts.second / counts.first : 0;
+      bool candidate = counts.first && share <= max_influence;
+      influences << entry.file << "," << entry.bits[i] << "," << counts.first << "," << counts.second << "," << share
+                 << "," << candidate << "\n";
+      if (candidate) {
+        drop += (drop.empty() ? "" : " ") + std::to_string(entry.bits[i]);
+      }
+    }
+    summary << entry.file << "," << entry.bits.size() << "," << known << "," << hex(address_mask) << ","
+            << (fit.coefficient < 0) << "," << errors << "," << (double)errors / known << "," << drop << "\n";
+
+    PLOG_INFO << entry.file << ": " << entry.bits.size() << " bits, " << known << " entries, transform took "
+              << seconds << "s";
+    PLOG_INFO << entry.file << ": best affine approximation " << hex(address_mask)
+              << (fit.coefficient < 0 ? " ^ 1" : "") << " differs on " << errors << " entries ("
+              << 100.0 * errors / known << "%)";
+    if (!drop.empty()) {
+      PLOG_WARNING << entry.file << ": bits " << drop << " change at most " << 100 * max_influence
+                   << "% of the entries, candidates to drop";
+    }
+  }
+  PLOG_INFO << "See " << dir << "/" SPECTRUM_SUMMARY " and " << dir << "/" SPECTRUM_INFLUENCE;
+}
+
+int main(int argc, char** argv) {
+  CLI::App app{"Walsh-Hadamard spectrum of the tables of a dump."};
+
+  std::string dir;
+  app.add_option("dir", dir, "Output directory of the dump")->required();
+
+  uint32_t min_margin = 0;
+  app.add_option("--min-margin", min_margin, "Entries with a vote margin below this are ignored");
+
+  double max_influence = 0.05;
+  app.add_option("--max-influence", max_influence,
+                 "Relevant bits that change at most this share of the entries are candidates to drop");
+
+  size_t workers = std::thread::hardware_concurrency();
+  app.add_option("-j,--jobs", workers, "Threads of the transform (number of cores if not given)");
+
+  CLI11_PARSE(app, argc, argv);
+
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::debug, &consoleAppender);
+
+  if (workers == 0) {
+    workers = 1;
+  }
+  try {
+    spectrum(dir, min_margin, max_influence, workers);
+  } catch (const std::exception& e) {
+    PLOG_FATAL << e.what();
+    exit(1);
+  }
+}
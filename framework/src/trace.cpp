@@ -0,0 +1,54 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <exception>
+
+#include "../include/trace.hpp"
+
+void write_trace_header(std::ostream& out, trace_header header, const boost::icl::interval_set<pointer>& ranges) {
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.range_count = ranges.iterative_size();
+  out.write((const char*)&header, sizeof(header));
+  for (auto range : ranges) {
+    pointer bounds[3] = {range.lower(), range.upper(), range.bounds().bits()};
+    out.write((const char*)bounds, sizeof(bounds));
+  }
+}
+
+/*
+ * Records are stored as they are in memory
+ */
+size_t format_trace_record(char* out, const trace_record& record) {
+  memcpy(out, &record, sizeof(record));
+  return sizeof(record);
+}
+
+/*
+ * Reads a whole trace, the mappable ranges are returned in ranges
+ */
+trace_header read_trace(std::string path, boost::icl::interval_set<pointer>& ranges, std::vector<trace_record>& records) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  trace_header header;
+  if (!in.read((char*)&header, sizeof(header)) || header.magic != TRACE_MAGIC) {
+    std::throw_with_nested(std::runtime_error(path + " is not a trace file"));
+  }
+  if (header.version != TRACE_VERSION) {
+    std::throw_with_nested(std::runtime_error(path + " has unsupported trace version " + std::to_string(header.version)));
+  }
+  for (size_t i = 0; i < header.range_count; i++) {
+    pointer bounds[3];
+    if (!in.read((char*)bounds, sizeof(bounds))) {
+      std::throw_with_nested(std::runtime_error(path + " is truncated"));
+    }
+    ranges += boost::icl::discrete_interval<pointer>(bounds[0], bounds[1], boost::icl::interval_bounds(bounds[2]));
+  }
+  trace_record record;
+  while (in.read((char*)&record, sizeof(record))) {
+    records.push_back(record);
+  }
+  return header;
+}
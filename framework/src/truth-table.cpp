@@ -0,0 +1,170 @@
+#include <charconv>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/truth-table.hpp"
+#include "../include/tiling.hpp"
+#include "../include/utils.hpp"
+
+/*
+ * Reads bits.csv, one line of relevant bits per output bit
+ */
+std::vector<std::vector<uint64_t>> read_bits_file(std::string path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  std::vector<std::vector<uint64_t>> bits;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::vector<uint64_t> line_bits;
+    size_t pos = 0;
+    while (pos < line.size()) {
+      auto comma = line.find(',', pos);
+      if (comma == std::string::npos) {
+        comma = line.size();
+      }
+      auto field = line.substr(pos, comma - pos);
+      if (field.find_first_not_of(" \t\r") != std::string::npos) {
+        line_bits.push_back(std::stoull(field));
+      }
+      pos = comma + 1;
+    }
+    bits.push_back(line_bits);
+  }
+  return bits;
+}
+
+void write_bits_file(std::string path, const std::vector<std::vector<uint64_t>>& bits) {
+  std::ofstream file(path);
+  for (auto& line_bits : bits) {
+    for (size_t i = 0; i < line_bits.size(); i++) {
+      file << (i ? ", " : "") << line_bits[i];
+    }
+    file << "\n";
+  }
+}
+
+truth_table make_truth_table(const std::vector<uint64_t>& bits) {
+  size_t entries = 1ULL << bits.size();
+  return truth_table{bits, std::vector<pointer>(entries, 0), std::vector<uint64_t>(entries, 0),
+                     std::vector<uint32_t>(entries, 0), std::vector<uint8_t>(entries, ENTRY_MISSING)};
+}
+
+/*
+ * Passes the lines of a dump to handle one at a time, the entry index is taken
+ * from the relevant bits of the address. The margin column is optional.
+ */
+void for_each_dump_entry(std::string path, const std::vector<uint64_t>& bits,
+                         const std::function<void(const dump_entry&)>& handle) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  std::string line;
+  std::getline(file, line);  // header
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    dump_entry entry{0, 0, 0, true, MARGIN_FULL};
+    auto end = line.data() + line.size();
+    auto parsed = std::from_chars(line.data(), end, entry.addr);
+    auto pos = parsed.ptr;
+    while (pos < end && (*pos == ',' || *pos == ' ')) {
+      pos++;
+    }
+    if (parsed.ec != std::errc() || pos == end) {
+      std::throw_with_nested(std::runtime_error(path + ": malformed line " + line));
+    }
+    if (*pos == '-') {
+      entry.mapped = false;
+      pos++;
+    } else {
+      parsed = std::from_chars(pos, end, entry.value);
+      if (parsed.ec != std::errc()) {
+        std::throw_with_nested(std::runtime_error(path + ": malformed line " + line));
+      }
+      pos = parsed.ptr;
+    }
+    while (pos < end && (*pos == ',' || *pos == ' ')) {
+      pos++;
+    }
+    if (pos < end && std::from_chars(pos, end, entry.margin).ec != std::errc()) {
+      std::throw_with_nested(std::runtime_error(path + ": malformed line " + line));
+    }
+    entry.index = idx_from_idx_vec_and_addr(bits, entry.addr);
+    handle(entry);
+  }
+}
+
+std::vector<dump_entry> read_dump(std::string path, const std::vector<uint64_t>& bits) {
+  std::vector<dump_entry> entries;
+  for_each_dump_entry(path, bits, [&](const dump_entry& entry) { entries.push_back(entry); });
+  return entries;
+}
+
+/*
+ * Reads a complete dump, later lines overwrite earlier ones of the same entry
+ */
+truth_table read_truth_table(std::string path, const std::vector<uint64_t>& bits) {
+  auto table = make_truth_table(bits);
+  for_each_dump_entry(path, bits, [&](const dump_entry& entry) {
+    table.addrs[entry.index] = entry.addr;
+    table.values[entry.index] = entry.value;
+    table.margins[entry.index] = entry.margin;
+    table.state[entry.index] = entry.mapped ? ENTRY_KNOWN : ENTRY_UNMAPPED;
+  });
+  return table;
+}
+
+/*
+ * Writes all entries that are not missing in index order
+ */
+void write_dump(std::string path, const truth_table& table) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::throw_with_nested(std::runtime_error(path + " could not be opened"));
+  }
+  file << DUMP_HEADER;
+  for (size_t x = 0; x < table.state.size(); x++) {
+    if (table.state[x] == ENTRY_KNOWN) {
+      file << table.addrs[x] << ", " << table.values[x] << ", " << table.margins[x] << "\n";
+    } else if (table.state[x] == ENTRY_UNMAPPED) {
+      file << table.addrs[x] << ", -, 0\n";
+    }
+  }
+}
+
+/*
+ * Lists the tables of a dump directory from its bits.csv and tiles.csv
+ */
+std::vector<dump_table> list_dump_tables(std::string dir, const std::vector<std::vector<uint64_t>>& bits) {
+  std::vector<dump_table> tables;
+  if (std::filesystem::exists(dir + "/" TILING_MANIFEST)) {
+    std::ifstream manifest(dir + "/" TILING_MANIFEST);
+    std::string line;
+    std::getline(manifest, line);
+    while (std::getline(manifest, line)) {
+      if (line.empty()) {
+        continue;
+      }
+      auto bit = std::stoll(line.substr(0, line.find(',')));
+      tables.push_back(dump_table{line.substr(line.rfind(',') + 1), bits[bit < 0 ? 0 : bit], bit < 0});
+    }
+    return tables;
+  }
+  if (std::filesystem::exists(dir + "/allbits.csv")) {
+    tables.push_back(dump_table{"allbits.csv", bits[0], true});
+  }
+  for (size_t bit = 0; bit < bits.size(); bit++) {
+    auto file = "bit_" + std::to_string(bit) + ".csv";
+    if (std::filesystem::exists(dir + "/" + file)) {
+      tables.push_back(dump_table{file, bits[bit], false});
+    }
+  }
+  return tables;
+}
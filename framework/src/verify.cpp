@@ -0,0 +1,128 @@
+#include <fcntl.h>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <plog/Log.h>
+
+#include "../include/verify.hpp"
+#include "../include/progress.hpp"
+
+/*
+ * Wilson score interval of a binomial proportion
+ */
+static std::pair<double, double> wilson_bounds(uint64_t successes, uint64_t trials) {
+  if (trials == 0) {
+    return {0, 1};
+  }
+  double p = (double)successes / trials;
+  double z2 = VERIFY_Z * VERIFY_Z;
+  double center = (p + z2 / (2 * trials)) / (1 + z2 / trials);
+  double spread = VERIFY_Z * std::sqrt(p * (1 - p) / trials + z2 / (4.0 * trials * trials)) / (1 + z2 / trials);
+  return {std::max(0.0, center - spread), std::min(1.0, center + spread)};
+}
+
+Verification::Verification(const HashFunction& function, bool direct, std::string output_dir) : function(function) {
+  if (!direct && function.output_bit >= 0) {
+    std::throw_with_nested(std::runtime_error("A solution of output bit " + std::to_string(function.output_bit) +
+                                              " needs an oracle that returns the hash, class labels have no bits"));
+  }
+  this->direct = direct;
+  this->file.open(output_dir + "/" VERIFY_FILE);
+  if (!this->file.is_open()) {
+    std::throw_with_nested(std::runtime_error(output_dir + "/" VERIFY_FILE " could not be opened"));
+  }
+  this->file << "addr,predicted,measured,repeated\n";
+}
+
+/*
+ * The part of an oracle response the function predicts
+ */
+uint64_t Verification::observe(uint64_t measured) {
+  return this->function.output_bit >= 0 ? (measured >> this->function.output_bit) & 0x1 : measured;
+}
+
+/*
+ * Compares with the hash value directly or with the one the label is bound to
+ */
+bool Verification::agrees(uint64_t measured, uint64_t predicted) {
+  if (this->direct) {
+    return predicted == measured;
+  }
+  return this->label_values.at(measured) == predicted;
+}
+
+/*
+ * Counts the robust remeasures that repeat a response
+ */
+size_t Verification::repeats(pointer mapped_addr, pointer select_addr, uint64_t measured,
+                             const std::function<uint64_t(pointer, pointer)>& measure) {
+  size_t repeated = 0;
+  for (size_t c = 0; c < VERIFY_CONFIRMATIONS; c++) {
+    repeated += this->observe(measure(mapped_addr, select_addr)) == measured;
+  }
+  return repeated;
+}
+
+/*
+ * Measures random addresses until the samples are done or a mismatch is
+ * confirmed, returns whether the function holds
+ */
+bool Verification::run(IAddr* addr, size_t samples, std::function<uint64_t(pointer, pointer)> measure) {
+  Progress::begin_run(samples);
+  Progress::begin_table(-1, samples);
+  bool refuted = false;
+  for (size_t i = 0; i < samples && !refuted; i++) {
+    pointer select_addr = addr->get_random_addr();
+    pointer mapped_addr = addr->map_addr(select_addr);
+    auto measured = this->observe(measure(mapped_addr, select_addr));
+    auto predicted = this->function.eval(select_addr);
+    this->samples++;
+    Progress::advance();
+
+    bool bound = this->direct || this->label_values.count(measured);
+    if (bound && this->agrees(measured, predicted)) {
+      this->agreeing++;
+      continue;
+    }
+    size_t repeated = this->repeats(mapped_addr, select_addr, measured, measure);
+    // Indirect oracles label classes in the order they discover them, a new
+    // label is bound to the hash value once the remeasures repeat it
+    if (!bound && repeated == VERIFY_CONFIRMATIONS && !this->value_labels.count(predicted)) {
+      this->label_values[measured] = predicted;
+      this->value_labels[predicted] = measured;
+      this->agreeing++;
+      continue;
+    }
+    this->file << "0x" << std::hex << select_addr << std::dec << "," << predicted << "," << measured << "," << repeated
+               << "\n";
+    if (repeated < VERIFY_CONFIRMATIONS) {
+      this->noise++;
+      continue;
+    }
+    PLOG_ERROR << "Mismatch at 0x" << std::hex << select_addr << std::dec << ": predicted " << predicted << ", measured "
+               << (this->direct ? "" : "class ") << measured << " in " << VERIFY_CONFIRMATIONS + 1
+               << " robust measurements"
+               << (this->label_values.count(measured)
+                       ? ", class " + std::to_string(measured) + " is hash value " + std::to_string(this->label_values[measured])
+                   : this->value_labels.count(predicted)
+                       ? ", hash value " + std::to_string(predicted) + " is class " + std::to_string(this->value_labels[predicted])
+                       : std::string(""));
+    refuted = true;
+  }
+  this->file.flush();
+  this->report(refuted);
+  return !refuted;
+}
+
+void Verification::report(bool refuted) {
+  auto bounds = wilson_bounds(this->agreeing, this->samples);
+  PLOG_INFO << "Agreement " << this->agreeing << "/" << this->samples << " ("
+            << 100.0 * this->agreeing / std::max<uint64_t>(this->samples, 1) << "%, 95% bounds " << 100 * bounds.first
+            << "% to " << 100 * bounds.second << "%), " << this->noise << " unconfirmed mismatches";
+  if (refuted) {
+    PLOG_ERROR << "The function does not hold, see " VERIFY_FILE;
+  } else {
+    PLOG_INFO << "The function holds, with 95% confidence at most " << 100 * (1 - bounds.first)
+              << "% of the addresses disagree";
+  }
+}
@@ -1,10 +1,184 @@
 #include <sys/mman.h>
+#include <linux/mman.h>
+#include <fcntl.h>
+#include <chrono>
 #include <plog/Log.h>
 
 #include "../include/addr.hpp"
 #include "../include/utils.hpp"
 
+#define VIRT_TLB_PROBES 65536 // random accesses used to count dTLB misses after mapping
+#define VIRT_DEFAULT_MAX_MAPS 65530 // mapping limit if /proc/sys/vm/max_map_count cannot be read
 
+static const char* backing_names[] = {"auto", "4K", "THP", "2M", "1G"};
+static const size_t backing_page_sizes[] = {0, 1ULL << 12, 1ULL << 21, 1ULL << 21, 1ULL << 30};
+
+virt_backing parse_virt_backing(std::string name){
+  for (auto& c : name) {
+    c = toupper(c);
+  }
+  for (int backing = VIRT_BACKING_AUTO; backing <= VIRT_BACKING_1G; backing++) {
+    std::string backing_name = backing_names[backing];
+    for (auto& c : backing_name) {
+      c = toupper(c);
+    }
+    if(name == backing_name){
+      return (virt_backing) backing;
+    }
+  }
+  std::throw_with_nested(std::runtime_error("Unknown page backing " + name + ", choose auto, 4k, thp, 2m or 1g"));
+}
+
+/*
+* Free pages of a hugetlbfs pool, 0 if the pool does not exist
+*/
+static uint64_t free_huge_pages(const char* pool){
+  std::ifstream file(std::string("/sys/kernel/mm/hugepages/") + pool + "/free_hugepages");
+  uint64_t pages = 0;
+  file >> pages;
+  return pages;
+}
+
+static bool thp_available(){
+  std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string modes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return modes.find("[always]") != std::string::npos || modes.find("[madvise]") != std::string::npos;
+}
+
+/*
+* Largest pages the system offers for a mapping of size bytes
+*/
+static virt_backing pick_backing(size_t size){
+  if(size >= backing_page_sizes[VIRT_BACKING_1G] && free_huge_pages("hugepages-1048576kB") >= size >> 30){
+    return VIRT_BACKING_1G;
+  }
+  if(size >= backing_page_sizes[VIRT_BACKING_2M] && free_huge_pages("hugepages-2048kB") >= size >> 21){
+    return VIRT_BACKING_2M;
+  }
+  if(size >= backing_page_sizes[VIRT_BACKING_THP] && thp_available()){
+    return VIRT_BACKING_THP;
+  }
+  return VIRT_BACKING_4K;
+}
+
+/*
+* Maps the address space with the given pages, returns nullptr if the system
+* cannot provide them
+*/
+char* VirtAddr::map_backing(virt_backing backing, bool populate){
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+  if(backing == VIRT_BACKING_1G){
+    flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+  }else if(backing == VIRT_BACKING_2M){
+    flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+  }
+  // Transparent huge pages are only used for faults after the madvise
+  if(populate && backing != VIRT_BACKING_THP){
+    flags |= MAP_POPULATE;
+  }
+  void* base = mmap((void*) (1ull<<(this->maxbits+1)), this->map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if(base == MAP_FAILED){
+    return nullptr;
+  }
+  if(backing == VIRT_BACKING_THP){
+    if(madvise(base, this->map_size, MADV_HUGEPAGE)){
+      munmap(base, this->map_size);
+      return nullptr;
+    }
+    for (size_t offset = 0; populate && offset < this->map_size; offset += backing_page_sizes[VIRT_BACKING_4K])
+    {
+      ((volatile char*) base)[offset] = 0;
+    }
+  }
+  return (char*) base;
+}
+
+/*
+* Maps one small memfd region repeatedly over the whole address space. The
+* utag hash only depends on virtual address bits, so the aliases cover wide
+* address ranges with the resident memory of one region.
+*/
+char* VirtAddr::map_aliased(size_t alias_bits){
+  // Every alias is a mapping of its own, keep them well below the limit of the system
+  uint64_t max_maps = VIRT_DEFAULT_MAX_MAPS;
+  std::ifstream("/proc/sys/vm/max_map_count") >> max_maps;
+  alias_bits = std::min(alias_bits, this->maxbits);
+  while (alias_bits < this->maxbits && (1ULL << (this->maxbits - alias_bits)) > max_maps / 2)
+  {
+    alias_bits++;
+  }
+  this->alias_size = 1ULL << alias_bits;
+  this->alias_fd = memfd_create("unscatter-alias", MFD_CLOEXEC);
+  if(this->alias_fd < 0 || ftruncate(this->alias_fd, this->alias_size)){
+    return nullptr;
+  }
+
+  // Reserve the address space and one more alias for the page after the last address. The
+  // kernel picks the place, aligned to the whole space if possible so that address bits are
+  // virtual address bits, otherwise to one alias as the aliases require.
+  size_t reserved = this->map_size + this->alias_size;
+  char* base = nullptr;
+  for (size_t align : {this->map_size, this->alias_size})
+  {
+    void* area = mmap(NULL, reserved + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(area == MAP_FAILED){
+      continue;
+    }
+    base = (char*) (((pointer) area + align - 1) & ~(align - 1));
+    if(base > (char*) area){
+      munmap(area, base - (char*) area);
+    }
+    munmap(base + reserved, (char*) area + reserved + align - (base + reserved));
+    if(align != this->map_size){
+      PLOG_WARNING << "Virtual memory is only aligned to " << align << " bytes, address bits from " << alias_bits
+                   << " on are offset by " << std::hex << (pointer) base << std::dec;
+    }
+    break;
+  }
+  if(!base){
+    return nullptr;
+  }
+  for (size_t offset = 0; offset < reserved; offset += this->alias_size)
+  {
+    if(mmap((char*) base + offset, this->alias_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, this->alias_fd, 0) == MAP_FAILED){
+      munmap(base, reserved);
+      return nullptr;
+    }
+  }
+  // Allocate the memory once, the other aliases only need page table entries
+  for (size_t offset = 0; offset < this->alias_size; offset += backing_page_sizes[VIRT_BACKING_4K])
+  {
+    ((volatile char*) base)[offset] = 0;
+  }
+  return (char*) base;
+}
+
+/*
+* Counts dTLB misses of random accesses, which disturb the utag measurements
+*/
+void VirtAddr::log_tlb_misses(){
+  try{
+    int fd = performance_counter_open(0, PERF_TYPE_HW_CACHE, PERF_CACHE_TYPE(PERF_COUNT_HW_CACHE_DTLB,
+                                      PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    performance_counter_reset(fd);
+    performance_counter_enable(fd);
+    for (size_t i = 0; i < VIRT_TLB_PROBES; i++)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      maccess(this->map_base + (state & (this->map_size - 1)));
+    }
+    performance_counter_disable(fd);
+    auto misses = performance_counter_read(fd);
+    close(fd);
+    PLOG_INFO << misses * 1000 / VIRT_TLB_PROBES << " dTLB misses per 1000 random accesses with " << backing_names[this->backing]
+              << " pages";
+  }catch (...){
+    PLOG_DEBUG << "dTLB misses cannot be counted";
+  }
+}
 
 bool VirtAddr::valid_address(pointer addr){
     return (addr < (1ull << this->maxbits));
@@ -16,14 +190,25 @@ pointer VirtAddr::get_random_addr(){
 
 pointer VirtAddr::map_addr(pointer addr)
 {
-    return (pointer) this->map_base+addr;
+    auto mapped = (pointer) this->map_base+addr;
+    // Aliases get their page table entries on first access, fault them in
+    // before the oracle measures, including the following page it accesses
+    if(this->alias_fd >= 0){
+        auto page = mapped >> 12;
+        auto& slot = this->faulted_pages[page & (this->faulted_pages.size() - 1)];
+        if(slot != page + 1){
+            slot = page + 1;
+            maccess((void*) mapped);
+            maccess((void*) (mapped + 4096));
+        }
+    }
+    return mapped;
 }
 
 std::pair<pointer,bool> VirtAddr::advance_bitmask_iterator(size_t step)
 {
     auto save = this->bitmsask_iterator_position;
-    this->bitmsask_iterator_position =
-      ((this->bitmsask_iterator_position | ~this->bitmask) + step) & this->bitmask;
+    this->bitmsask_iterator_position = this->next_iterator_position(step);
     if(!valid_address(save)){
         return std::make_pair(save,false);
     }
@@ -38,21 +223,89 @@ pointer VirtAddr::flip_unused_bits(pointer addr){
   return rand_mask ^ addr;
 }
 
-VirtAddr::VirtAddr(size_t maxbits)
+pointer VirtAddr::unmap_addr(pointer mapped)
+{
+    return mapped - (pointer) this->map_base;
+}
+
+/*
+* Unbacked address spaces map every address to itself, they are used when
+* no memory is accessed e.g. during replays
+*/
+VirtAddr::VirtAddr(size_t maxbits, bool backed, virt_backing backing, bool populate, size_t alias_bits)
 {   
     this->maxbits = maxbits;
+    this->map_base = nullptr;
+    this->map_size = 1ull << maxbits;
+    this->backing = backing;
+    this->alias_fd = -1;
+    this->alias_size = 0;
+    if(!backed){
+        PLOG_INFO << "Using " << maxbits << " bits of unbacked virtual addresses";
+        return;
+    }
 
-    PLOG_INFO << "Mapping " << maxbits << " of virtual addresses";
-    PLOG_INFO << "Mapping " << this->maxbits << " of virtual addresses";
-    this->map_base = (char*) mmap((void*) (1ull<<(this->maxbits+1)), (1ull<<this->maxbits), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_FIXED, -1, 0);
-    if(this->map_base == MAP_FAILED){
+    if(maxbits < VIRT_MIN_BITS || maxbits >= VIRT_USER_BITS){
+        std::throw_with_nested(std::runtime_error("Cannot map " + std::to_string(maxbits) + " bits of virtual addresses, choose " +
+                                                  std::to_string(VIRT_MIN_BITS) + " to " + std::to_string(VIRT_USER_BITS - 1) + " bits"));
+    }
+    PLOG_INFO << "Mapping " << this->maxbits << " bits of virtual addresses";
+    auto start = std::chrono::steady_clock::now();
+    if(alias_bits){
+        if(alias_bits < VIRT_MIN_BITS){
+            std::throw_with_nested(std::runtime_error("Cannot alias regions of " + std::to_string(alias_bits) + " bits, aliases span at least " +
+                                                      std::to_string(VIRT_MIN_BITS) + " bits"));
+        }
+        this->backing = VIRT_BACKING_4K;
+        this->map_base = map_aliased(alias_bits);
+        if(!this->map_base){
+            PLOG_FATAL << "Cannot map " << this->maxbits << " bits of virtual memory as aliases, aborting";
+            exit(1);
+        }
+        // Covers the whole space when it fits, otherwise remembers the pages of the last table entries
+        this->faulted_pages.assign(std::min<size_t>(this->map_size >> 12, VIRT_FAULT_SLOTS), 0);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        PLOG_INFO << "Mapped virtual memory as " << (this->map_size / this->alias_size) + 1 << " aliases of a " << this->alias_size
+                  << " byte region in " << duration.count() << "ms";
+        return;
+    }
+    if(backing == VIRT_BACKING_AUTO){
+        backing = pick_backing(this->map_size);
+    }
+    // Fall back to smaller pages if the system cannot provide the requested ones
+    for (int candidate = backing; candidate > VIRT_BACKING_AUTO && !this->map_base; candidate--)
+    {
+        if(backing_page_sizes[candidate] > this->map_size){
+            PLOG_WARNING << "Virtual memory is smaller than a " << backing_names[candidate] << " page, falling back to smaller pages";
+            continue;
+        }
+        this->map_base = map_backing((virt_backing) candidate, populate);
+        this->backing = (virt_backing) candidate;
+        if(!this->map_base){
+            PLOG_WARNING << "Cannot map virtual memory with " << backing_names[candidate] << " pages, falling back to smaller pages";
+        }
+    }
+    if(!this->map_base){
         PLOG_FATAL << "Cannot map " << this->maxbits << " bits of virtual memory, aborting";
         exit(1);
     }
-    PLOG_INFO << "Mapped virtual memory";
-
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    PLOG_INFO << "Mapped virtual memory with " << this->map_size / backing_page_sizes[this->backing] << " " << backing_names[this->backing]
+              << " pages in " << duration.count() << "ms" << (populate ? "" : ", pages are populated on first access");
+    if(this->backing != VIRT_BACKING_4K){
+        PLOG_INFO << "4K pages would need " << this->map_size / backing_page_sizes[VIRT_BACKING_4K] << " TLB entries instead of "
+                  << this->map_size / backing_page_sizes[this->backing];
+    }
+    if(populate){
+        log_tlb_misses();
+    }
 }
 
 VirtAddr::~VirtAddr(){
-    free(this->map_base);
+    if(this->map_base){
+        munmap(this->map_base, this->map_size + this->alias_size);
+    }
+    if(this->alias_fd >= 0){
+        close(this->alias_fd);
+    }
 }
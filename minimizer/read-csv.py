@@ -1,12 +1,17 @@
 import sys
 
 if len(sys.argv) < 3:
-    print("./read-csv.py <path to folder with CSVs> <bit number> [negate]")
+    print("./read-csv.py <path to folder with CSVs> <bit number> [negate] [min-margin=<percent>]")
+    print("Entries that are unmapped or decided with a vote margin below min-margin are written as don't cares")
     exit(1)
 
 path = sys.argv[1]
 bit_num = int(sys.argv[2])
-negate = 0 if len(sys.argv) == 4 and sys.argv[3] == "negate" else 1
+negate = 0 if "negate" in sys.argv[3:] else 1
+min_margin = 0
+for arg in sys.argv[3:]:
+    if arg.startswith("min-margin="):
+        min_margin = int(arg.split("=")[1])
 
 with open(f"{path}/bit_{bit_num}.csv") as f:
     data = f.readlines()
@@ -22,17 +27,20 @@ n = len(relevant_bits)
 outfile = f"{path}/bit_{bit_num}.espresso.in"
 
 seen = set()
+dont_cares = 0
 
 with open(outfile, "w") as f:
 
     f.write(f".i {n}\n")
     f.write(f".o 1\n")
+    # On set, off set and don't cares are all listed explicitly
+    f.write(f".type fdr\n")
 
     for line in data[1:]:
-        x,y = line.split(",")
-
-        x = int(x)
-        y = int(y)
+        fields = [field.strip() for field in line.split(",")]
+        x = int(fields[0])
+        # Dumps without a margin column are fully confident
+        margin = int(fields[2]) if len(fields) > 2 else 100
 
         bin_repr = ""
 
@@ -44,15 +52,18 @@ with open(outfile, "w") as f:
 
         seen.add(bit_val)
 
-        if y == negate:
-            f.write(f"{bin_repr} {1}\n")
+        if fields[1] == "-" or margin < min_margin:
+            f.write(f"{bin_repr} -\n")
+            dont_cares += 1
+        elif int(fields[1]) == negate:
+            f.write(f"{bin_repr} 1\n")
         else:
-            pass
+            f.write(f"{bin_repr} 0\n")
 
     f.write(".e\n")
 
 
-print(f"Output written to {outfile}/")
+print(f"Output written to {outfile}/, {dont_cares} don't cares")
 print(f"espresso {outfile} > {path}/bit_{bit_num}.espresso.sol")
 print(f"sage minimize-groebner.sage {path}/bit_{bit_num}.espresso.sol")
 
@@ -0,0 +1,73 @@
+import os
+import sys
+
+if len(sys.argv) < 3 or (len(sys.argv) == 4 and sys.argv[3] != "split"):
+    print("./stitch-tiles.py <path to folder with tiles.csv> <output folder> [split]")
+    print("Stitches the tiles of every table into one bit_<n>.csv, with split every tile gets its own folder")
+    exit(1)
+
+path = sys.argv[1]
+out = sys.argv[2]
+split = len(sys.argv) == 4
+
+with open(f"{path}/tiles.csv") as f:
+    manifest = [line.strip().split(",") for line in f.readlines()[1:] if line.strip() != '']
+
+with open(f"{path}/bits.csv") as f:
+    bits_data = f.readlines()
+
+
+def mask_bits(mask):
+    return [b for b in range(64) if (mask >> b) & 1]
+
+
+def table_name(bit):
+    return "allbits.csv" if bit < 0 else f"bit_{bit}.csv"
+
+
+tables = {}
+for bit, tile, fixed_mask, fixed_value, file in manifest:
+    tables.setdefault(int(bit), []).append((int(tile), int(fixed_mask, 16), int(fixed_value, 16), file))
+
+os.makedirs(out, exist_ok=True)
+full_bits = {}
+for bit, tiles in sorted(tables.items()):
+    line = bits_data[max(bit, 0)]
+    relevant_bits = [int(x.strip()) for x in line.split(",") if x.strip() != '']
+    fixed_bits = mask_bits(tiles[0][1])
+    full_bits[bit] = sorted(relevant_bits + fixed_bits)
+
+    if split:
+        # Every tile is a table over the bits within the limits
+        for tile, fixed_mask, fixed_value, file in tiles:
+            tile_dir = f"{out}/tile_{tile}"
+            os.makedirs(tile_dir, exist_ok=True)
+            with open(f"{path}/{file}") as src, open(f"{tile_dir}/{table_name(bit)}", "w") as dst:
+                dst.write(src.read())
+        continue
+
+    seen = set()
+    with open(f"{out}/{table_name(bit)}", "w") as dst:
+        dst.write("addr,class,margin\n")
+        for tile, fixed_mask, fixed_value, file in tiles:
+            with open(f"{path}/{file}") as src:
+                for entry in src.readlines()[1:]:
+                    x = int(entry.split(",")[0])
+                    # Entries of different tiles differ in the fixed bits
+                    assert x & fixed_mask == fixed_value, f"{file}: {x:#x} is not in tile {tile}"
+                    seen.add(sum(((x >> b) & 1) << i for i, b in enumerate(full_bits[bit])))
+                    dst.write(entry)
+    assert len(seen) == 2 ** len(full_bits[bit]), f"{table_name(bit)}: {len(seen)=} n={len(full_bits[bit])}"
+    print(f"{table_name(bit)}: {len(tiles)} tiles over {len(full_bits[bit])} bits")
+
+# Tiles keep the bits within the limits, a stitched table has all relevant bits
+bits_dirs = [f"{out}/tile_{tile}" for tile in {t[0] for tiles in tables.values() for t in tiles}] if split else [out]
+for bits_dir in bits_dirs:
+    with open(f"{bits_dir}/bits.csv", "w") as f:
+        for bit in range(max(max(tables.keys()), 0) + 1):
+            if split or bit not in full_bits:
+                f.write(bits_data[bit])
+            else:
+                f.write(", ".join(str(b) for b in full_bits[bit]) + "\n")
+
+print(f"Output written to {out}/")
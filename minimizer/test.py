@@ -226,10 +226,12 @@ def read_bits_csv(path, bit_num):
     n = len(relevant_bits)
 
     values = []
-    for line in data:
-        x, y = line.split(",")
-        x = int(x)
-        y = int(y)
+    for line in data[1:]:
+        fields = line.split(",")
+        if fields[1].strip() == "-":
+            continue
+        x = int(fields[0])
+        y = int(fields[1])
 
         bin_repr = []
         for bits in relevant_bits:
@@ -244,15 +246,19 @@ def read_espresso_in(path):
         data = f.readlines()
 
     values = []
+    dont_cares = []
     seen_inputs = set()
+    explicit_off_set = False
     n = -1
     for line in data:
         line = line.strip()
         if line[0] == ".":
+            # With an r in the type the off set is listed, missing inputs are don't cares
+            if line.startswith(".type") and "r" in line.split()[1]:
+                explicit_off_set = True
             continue
 
         x, y = line.split(" ")
-        y = int(y)
 
         assert n == -1 or n == len(x)
         n = len(x)
@@ -262,15 +268,21 @@ def read_espresso_in(path):
             assert bit == "1" or bit == "0", "found wildcard, this does not work."
             bin_repr.append(int(bit))
 
-        values.append((tuple(bin_repr), y))
         seen_inputs.add(tuple(bin_repr))
+        if y == "-":
+            dont_cares.append(tuple(bin_repr))
+        else:
+            values.append((tuple(bin_repr), int(y)))
 
     for bits in it.product([0, 1], repeat=n):
         if bits not in seen_inputs:
-            values.append((bits, 0))
+            if explicit_off_set:
+                dont_cares.append(bits)
+            else:
+                values.append((bits, 0))
 
 
-    return n, values
+    return n, values, dont_cares
 
 def read_blackbox():
     n = 6
@@ -281,20 +293,26 @@ def read_blackbox():
     return (n, values)
 
 
-def compute_groebner_basis(bits, values):
+def compute_groebner_basis(bits, values, dont_cares=()):
     global _TIME_IN_ESPRESSO, _TIME_IN_GROEBNER, _TOTAL_GROEBNER_CALLS
 
     _TOTAL_GROEBNER_CALLS += 1
 
     n = len(bits)
-    print(f"Starting Espresso ({n} bits, {len(values)} truth-values).")
+    print(f"Starting Espresso ({n} bits, {len(values)} truth-values, {len(dont_cares)} don't cares).")
     espresso = subprocess.Popen(ESPRESSO_EXECUTABLE, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     write = lambda line: espresso.stdin.write(line.encode())
     write(f".i {n}\n")
     write(f".o 1\n")
+    if dont_cares:
+        write(".type fd\n")
     for bitstring in values:
         bin_repr = "".join(map(str, bitstring))
         write(f"{bin_repr} {1}\n")
+    # Espresso may cover don't cares or not, whatever gives the smaller cover
+    for bitstring in dont_cares:
+        bin_repr = "".join(map(str, bitstring))
+        write(f"{bin_repr} -\n")
     write(".e\n")
 
 
@@ -342,8 +360,8 @@ def compute_groebner_basis(bits, values):
 
 seen = set()
 
-def minimize_rec(x, bitstrings, negate=False, depth=0, size=10**10):
-    basis = compute_groebner_basis(x, bitstrings)
+def minimize_rec(x, bitstrings, negate=False, depth=0, size=10**10, dont_cares=()):
+    basis = compute_groebner_basis(x, bitstrings, dont_cares)
     newsize = sum( len(list(str(b))) for b in basis )
     if newsize > size:
         return None
@@ -388,7 +406,7 @@ path = sys.argv[1]
 negate = sys.argv[2] == "negate" if len(sys.argv) > 2 else False
 
 
-n, data = read_espresso_in(path)
+n, data, dont_cares = read_espresso_in(path)
 
 
 check_value = 1 if not negate else 0
@@ -397,7 +415,7 @@ values = [ value for value, y in data if y == check_value ]
 R = PolynomialRing(GF(2), "x", n)
 x = R.gens()
 
-tree = minimize_rec(x, values, negate=negate)
+tree = minimize_rec(x, values, negate=negate, dont_cares=dont_cares)
 tree = modify(tree, simplify_all)
 tree = modify(tree, simplify_all)
 